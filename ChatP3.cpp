@@ -3,10 +3,21 @@
 #include <string>
 #include <cstring>
 #include <unistd.h>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cerrno>
+#include <cstdint>
 
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
 
 #define PORT 8000
 #define BUFFERSIZE 1024
@@ -29,12 +40,383 @@ void configurarCliente(int sock, struct sockaddr_in &conf) {
     }
 }
 
-int main(int argc, char const *argv[]) {
-    if (argc < 2)
-        return 0;
-    
-    std::string nombreCliente = argv[1];
+// ---------------------------------------------------------------------------
+// Modo carga: N bots sin interfaz, cada uno con su propio nombre, generan
+// tráfico de chat, trivia y RPS a una tasa objetivo y se mide la latencia.
+//  - Ida y vuelta: "/ping <t>" enviado en el instante t, el servidor responde
+//    "PONG <t>".
+//  - Entrega de difusión: cada mensaje de chat lleva "#t<ns>"; cualquier bot
+//    que lo reciba registra ahora - ns. Todos los bots viven en este proceso,
+//    así que comparten el mismo reloj monótono.
+// ---------------------------------------------------------------------------
+
+using Reloj = std::chrono::steady_clock;
+
+struct OpcionesCarga {
+    int bots = 10;
+    double tasa = 100.0;        // mensajes por segundo entre todos los bots
+    int duracionSeg = 10;
+    int pesoChat = 70;
+    int pesoPing = 20;
+    int pesoTrivia = 2;
+    int pesoRPS = 8;
+    std::string prefijo = "bot";
+    std::string sala = "carga";  // el chat se difunde solo dentro de una sala
+    std::string host = "127.0.0.1";
+    int puerto = PORT;
+};
+
+struct Bot {
+    int sock = -1;
+    std::string nombre;
+    std::string entrada;        // bytes recibidos aún sin fin de línea
+    std::string salida;         // bytes que el socket no aceptó todavía
+    bool listo = false;         // ya recibió la bienvenida del servidor
+    bool enJuego = false;       // en una partida RPS: no envía chat
+    bool cerrado = false;
+};
+
+struct Medicion {
+    std::vector<int64_t> idaVuelta;   // ns
+    std::vector<int64_t> difusion;    // ns
+    uint64_t enviados = 0;
+    uint64_t lineas = 0;
+    uint64_t bytesEnviados = 0;
+    uint64_t bytesRecibidos = 0;
+    uint64_t omitidos = 0;            // turnos perdidos por estar en partida
+    uint64_t desconexiones = 0;
+    uint64_t limitados = 0;           // avisos de límite de tasa del servidor
+};
+
+static int64_t ahoraNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Reloj::now().time_since_epoch()).count();
+}
+
+static std::mt19937 genCarga(std::random_device{}());
+
+static int azar(int n) {
+    return std::uniform_int_distribution<int>(0, n - 1)(genCarga);
+}
+
+static void enviarBot(int epfd, Bot &b, const std::string &texto, Medicion &m) {
+    if (b.cerrado) return;
+    m.enviados++;
+    m.bytesEnviados += texto.size();
+    if (!b.salida.empty()) {
+        b.salida += texto;
+        return;
+    }
+    ssize_t n = send(b.sock, texto.data(), texto.size(), MSG_NOSIGNAL);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return;
+        n = 0;
+    }
+    if ((size_t)n < texto.size()) {
+        // El socket está lleno: esperar EPOLLOUT para el resto
+        b.salida.assign(texto, n, std::string::npos);
+        struct epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.ptr = &b;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, b.sock, &ev);
+    }
+}
+
+static void vaciarBot(int epfd, Bot &b) {
+    while (!b.salida.empty()) {
+        ssize_t n = send(b.sock, b.salida.data(), b.salida.size(), MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            b.salida.clear();
+            break;
+        }
+        b.salida.erase(0, n);
+    }
+    struct epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &b;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, b.sock, &ev);
+}
+
+// Lee el número que sigue a 'pos' en la línea (token de tiempo)
+static bool leerNs(const std::string &linea, size_t pos, int64_t &ns) {
+    size_t fin = pos;
+    while (fin < linea.size() && isdigit((unsigned char)linea[fin])) ++fin;
+    if (fin == pos) return false;
+    ns = std::stoll(linea.substr(pos, fin - pos));
+    return true;
+}
+
+// Reacciona a una línea del servidor: mide latencias y contesta los juegos
+static void procesarLineaBot(int epfd, Bot &b, const std::string &linea, const OpcionesCarga &op, Medicion &m, bool midiendo) {
+    static const char *movimientos[] = {"piedra", "papel", "tijera"};
+    static const char *respuestas[] = {"God of War", "World at War", "Mario", "verde"};
+    int64_t ns;
 
+    m.lineas++;
+    if (linea.compare(0, 5, "PONG ") == 0) {
+        if (midiendo && leerNs(linea, 5, ns)) m.idaVuelta.push_back(ahoraNs() - ns);
+        return;
+    }
+    size_t marca = linea.rfind("#t");
+    if (marca != std::string::npos && leerNs(linea, marca + 2, ns)) {
+        if (midiendo) m.difusion.push_back(ahoraNs() - ns);
+        return;
+    }
+    if (linea.compare(0, 19, "Demasiados mensajes") == 0) {
+        m.limitados++;
+    } else if (linea.find("Menu principal") != std::string::npos) {
+        b.enJuego = false;
+    } else if (linea.find("elige: piedra") != std::string::npos || linea.find("Envía 'piedra'") != std::string::npos) {
+        enviarBot(epfd, b, std::string(movimientos[azar(3)]) + "\n", m);
+    } else if (linea.find("otra ronda") != std::string::npos) {
+        enviarBot(epfd, b, "no\n", m);
+    } else if (linea.compare(0, 10, "Pregunta: ") == 0 && azar(op.bots) < 2) {
+        // En promedio dos bots responden cada pregunta
+        enviarBot(epfd, b, std::string(respuestas[azar(4)]) + "\n", m);
+    }
+}
+
+// Ejecuta la siguiente acción del guion del bot según los pesos configurados
+static void accionBot(int epfd, Bot &b, const OpcionesCarga &op, Medicion &m) {
+    if (b.cerrado || !b.listo) return;
+    if (b.enJuego) {
+        m.omitidos++;
+        return;
+    }
+    int total = op.pesoChat + op.pesoPing + op.pesoTrivia + op.pesoRPS;
+    int r = azar(total);
+    if ((r -= op.pesoChat) < 0) {
+        enviarBot(epfd, b, "hola desde " + b.nombre + " #t" + std::to_string(ahoraNs()) + "\n", m);
+    } else if ((r -= op.pesoPing) < 0) {
+        enviarBot(epfd, b, "/ping " + std::to_string(ahoraNs()) + "\n", m);
+    } else if ((r -= op.pesoTrivia) < 0) {
+        enviarBot(epfd, b, "/juego_trivia\n", m);
+    } else {
+        // vs máquina o vs otro bot; los prompts se contestan al llegar
+        b.enJuego = true;
+        enviarBot(epfd, b, azar(2) == 0 ? "/piedra_papel_tijera\n1\n" : "/piedra_papel_tijera\n2\n", m);
+    }
+}
+
+static void leerBot(int epfd, Bot &b, const OpcionesCarga &op, Medicion &m, bool midiendo) {
+    char buffer[16 * BUFFERSIZE];
+    while (true) {
+        ssize_t n = read(b.sock, buffer, sizeof(buffer));
+        if (n > 0) {
+            m.bytesRecibidos += n;
+            b.entrada.append(buffer, n);
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        // El servidor cerró la conexión
+        if (!b.cerrado) m.desconexiones++;
+        b.cerrado = true;
+        epoll_ctl(epfd, EPOLL_CTL_DEL, b.sock, nullptr);
+        break;
+    }
+    if (!b.entrada.empty()) b.listo = true;
+    size_t inicio = 0, fin;
+    while ((fin = b.entrada.find('\n', inicio)) != std::string::npos) {
+        procesarLineaBot(epfd, b, b.entrada.substr(inicio, fin - inicio), op, m, midiendo);
+        inicio = fin + 1;
+    }
+    b.entrada.erase(0, inicio);
+}
+
+static void reportarPercentiles(const char *titulo, std::vector<int64_t> &v) {
+    std::cout << titulo << ": n=" << v.size();
+    if (v.empty()) {
+        std::cout << std::endl;
+        return;
+    }
+    std::sort(v.begin(), v.end());
+    auto p = [&](double q) { return v[std::min(v.size() - 1, (size_t)(q * v.size()))] / 1000.0; };
+    std::cout << "  p50=" << p(0.50) << " us  p99=" << p(0.99) << " us  p999=" << p(0.999)
+              << " us  max=" << v.back() / 1000.0 << " us" << std::endl;
+}
+
+static void mostrarUsoCarga(const char *prog) {
+    std::cerr << "Uso: " << prog << " --carga <nBots> [opciones]\n"
+              << "  --tasa=MSG_S       mensajes por segundo entre todos los bots (defecto 100)\n"
+              << "  --duracion=SEG     duración de la medición (defecto 10)\n"
+              << "  --mezcla=C,P,T,R   pesos de chat, /ping, trivia y RPS (defecto 70,20,2,8)\n"
+              << "  --prefijo=NOMBRE   prefijo de los nombres de los bots (defecto bot)\n"
+              << "  --sala=NOMBRE      sala donde chatean los bots (defecto carga)\n"
+              << "  --host=IP --puerto=N" << std::endl;
+}
+
+static bool leerOpcionesCarga(int argc, char const *argv[], OpcionesCarga &op) {
+    if (argc < 3) return false;
+    try {
+        op.bots = std::stoi(argv[2]);
+        for (int i = 3; i < argc; ++i) {
+            std::string arg = argv[i];
+            size_t igual = arg.find('=');
+            std::string nombre = arg.substr(0, igual);
+            std::string valor = (igual == std::string::npos ? "" : arg.substr(igual + 1));
+            if (nombre == "--tasa") op.tasa = std::stod(valor);
+            else if (nombre == "--duracion") op.duracionSeg = std::stoi(valor);
+            else if (nombre == "--prefijo") op.prefijo = valor;
+            else if (nombre == "--sala") op.sala = valor;
+            else if (nombre == "--host") op.host = valor;
+            else if (nombre == "--puerto") op.puerto = std::stoi(valor);
+            else if (nombre == "--mezcla") {
+                if (sscanf(valor.c_str(), "%d,%d,%d,%d", &op.pesoChat, &op.pesoPing, &op.pesoTrivia, &op.pesoRPS) != 4)
+                    return false;
+            } else {
+                std::cerr << "Opción desconocida: " << arg << std::endl;
+                return false;
+            }
+        }
+    } catch (const std::exception &e) {
+        return false;
+    }
+    return op.bots >= 1 && !op.sala.empty() && op.tasa > 0 && op.duracionSeg >= 1 && op.pesoChat >= 0 && op.pesoPing >= 0
+        && op.pesoTrivia >= 0 && op.pesoRPS >= 0 && op.pesoChat + op.pesoPing + op.pesoTrivia + op.pesoRPS > 0;
+}
+
+static int ejecutarCarga(const OpcionesCarga &op) {
+    int epfd = epoll_create1(0);
+    if (epfd < 0) {
+        std::cerr << "Error epoll_create1" << std::endl;
+        return 1;
+    }
+    Medicion m;
+    std::vector<Bot> bots(op.bots);
+
+    // 1. Conectar y registrar a cada bot
+    struct sockaddr_in conf{};
+    conf.sin_family = AF_INET;
+    conf.sin_port = htons(op.puerto);
+    conf.sin_addr.s_addr = inet_addr(op.host.c_str());
+    for (int i = 0; i < op.bots; ++i) {
+        Bot &b = bots[i];
+        b.nombre = op.prefijo + std::to_string(i);
+        crearSocket(b.sock);
+        if (connect(b.sock, (struct sockaddr *)&conf, sizeof(conf)) < 0) {
+            std::cerr << "Connection Failed (" << b.nombre << ")" << std::endl;
+            return 1;
+        }
+        // Sin Nagle: la latencia medida debe ser la del servidor, no la del bot
+        int uno = 1;
+        setsockopt(b.sock, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+        fcntl(b.sock, F_SETFL, fcntl(b.sock, F_GETFL) | O_NONBLOCK);
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = &b;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, b.sock, &ev);
+        enviarBot(epfd, b, b.nombre + "\n/unirse " + op.sala + "\n", m);
+    }
+
+    // 2. Agenda: cada bot actúa cada nBots/tasa segundos, desfasados entre sí
+    using Turno = std::pair<Reloj::time_point, int>;
+    std::priority_queue<Turno, std::vector<Turno>, std::greater<Turno>> agenda;
+    auto intervalo = std::chrono::duration_cast<Reloj::duration>(std::chrono::duration<double>(op.bots / op.tasa));
+    auto inicio = Reloj::now() + std::chrono::milliseconds(500); // margen para los registros
+    for (int i = 0; i < op.bots; ++i)
+        agenda.emplace(inicio + intervalo * i / op.bots, i);
+    auto fin = inicio + std::chrono::seconds(op.duracionSeg);
+    auto cierre = fin + std::chrono::seconds(1); // recoger lo que aún viaja
+
+    std::cout << "Carga: " << op.bots << " bots, tasa objetivo " << op.tasa << " msg/s, "
+              << op.duracionSeg << " s" << std::endl;
+
+    // 3. Bucle de eventos
+    struct epoll_event eventos[256];
+    Medicion base;
+    bool midiendo = false;
+    while (true) {
+        auto ahora = Reloj::now();
+        if (!midiendo && ahora >= inicio) {
+            base = m; // lo anterior fue el registro
+            midiendo = true;
+        }
+        if (ahora >= cierre) break;
+        while (!agenda.empty() && agenda.top().first <= ahora) {
+            auto [cuando, i] = agenda.top();
+            agenda.pop();
+            if (cuando >= fin) continue;
+            accionBot(epfd, bots[i], op, m);
+            agenda.emplace(cuando + intervalo, i);
+        }
+        auto proximo = agenda.empty() ? cierre : std::min(cierre, agenda.top().first);
+        int espera = (int)std::chrono::duration_cast<std::chrono::milliseconds>(proximo - Reloj::now()).count();
+        int n = epoll_wait(epfd, eventos, 256, std::max(espera, 0));
+        if (n < 0 && errno != EINTR) {
+            std::cerr << "Error epoll_wait" << std::endl;
+            return 1;
+        }
+        for (int e = 0; e < n; ++e) {
+            Bot &b = *static_cast<Bot *>(eventos[e].data.ptr);
+            if (eventos[e].events & EPOLLOUT) vaciarBot(epfd, b);
+            if (eventos[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) leerBot(epfd, b, op, m, midiendo && Reloj::now() < fin);
+        }
+    }
+
+    // 4. Despedida y reporte
+    for (auto &b : bots) {
+        if (!b.cerrado) send(b.sock, "BYE\n", 4, MSG_NOSIGNAL);
+        close(b.sock);
+    }
+    close(epfd);
+
+    double seg = op.duracionSeg;
+    std::cout << "Enviados: " << m.enviados - base.enviados << " mensajes ("
+              << (m.enviados - base.enviados) / seg << " msg/s, "
+              << (m.bytesEnviados - base.bytesEnviados) / seg / 1024 << " KiB/s)" << std::endl;
+    std::cout << "Recibidos: " << m.lineas - base.lineas << " líneas ("
+              << (m.lineas - base.lineas) / seg << " líneas/s, "
+              << (m.bytesRecibidos - base.bytesRecibidos) / seg / 1024 << " KiB/s)" << std::endl;
+    std::cout << "Turnos omitidos (en partida): " << m.omitidos << ", desconexiones: " << m.desconexiones
+              << ", avisos de límite de tasa: " << m.limitados << std::endl;
+    reportarPercentiles("Ida y vuelta (/ping)", m.idaVuelta);
+    reportarPercentiles("Entrega de difusión (chat)", m.difusion);
+    return m.desconexiones == 0 ? 0 : 2;
+}
+
+// ---------------------------------------------------------------------------
+// Modo interactivo. Un solo bucle poll() atiende el teclado y el socket: lo
+// que envía el servidor (difusiones, preguntas de trivia, avisos de PvP) se
+// muestra apenas llega, sin esperar a que el usuario presione enter, y cada
+// lectura del socket se drena completa.
+// ---------------------------------------------------------------------------
+
+// Envía todo el texto aunque send() lo acepte por partes
+static bool enviarTodo(int sock, const std::string &texto) {
+    size_t enviado = 0;
+    while (enviado < texto.size()) {
+        ssize_t n = send(sock, texto.data() + enviado, texto.size() - enviado, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        enviado += n;
+    }
+    return true;
+}
+
+// Muestra todo lo que haya en el socket. Devuelve false si el servidor cerró
+// (tras despedirse con BYE el cierre es lo esperado y no se avisa).
+static bool mostrarDelServidor(int sock, bool avisarCierre) {
+    char buffer[BUFFERSIZE];
+    bool algo = false;
+    while (true) {
+        ssize_t n = recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n > 0) {
+            std::cout.write(buffer, n);
+            algo = true;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) std::cerr << "Error al recibir: " << std::strerror(errno) << std::endl;
+        else if (avisarCierre) std::cerr << "Servidor cerró la conexión" << std::endl;
+        return false;
+    }
+    if (algo) std::cout << "Mensaje: ";
+    std::cout.flush();
+    return true;
+}
+
+static int ejecutarInteractivo(const std::string &nombreCliente) {
     // 1. Crear Socket
     int sockCliente;
     crearSocket(sockCliente);
@@ -42,86 +424,73 @@ int main(int argc, char const *argv[]) {
     // 2. Conectarse al Servidor
     struct sockaddr_in confServidor;
     configurarCliente(sockCliente, confServidor);
-   
-    bool primerMensaje = true;
-    
-    // 3. Comunicarse
+    // Las respuestas de trivia salen sin esperar a Nagle: la latencia decide quién gana
+    int uno = 1;
+    setsockopt(sockCliente, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+
+    // 3. Comunicarse: el nombre va como la primera línea
+    if (!enviarTodo(sockCliente, nombreCliente + "\n")) {
+        std::cerr << "Error al enviar nombre" << std::endl;
+        close(sockCliente);
+        return 1;
+    }
+
+    std::string pendiente;       // lo tecleado que aún no completa una línea
+    bool tecladoAbierto = true;
     while (true) {
-        char buffer[BUFFERSIZE] = {0};
-        char buffer2[BUFFERSIZE] = {0};
-        
-        if (primerMensaje) {
-            // Enviar nombre del cliente
-            int sent = send(sockCliente, nombreCliente.c_str(), nombreCliente.length(), 0);
-            if (sent < 0) {
-                std::cerr << "Error al enviar nombre" << std::endl;
-                break;
-            }
-            
-            // Recibir respuesta inicial
-            int valread = read(sockCliente, buffer, BUFFERSIZE - 1);
-            if (valread < 0) {
-                std::cerr << "Error al recibir respuesta inicial" << std::endl;
-                break;
-            } else if (valread == 0) {
-                std::cerr << "Servidor cerró la conexión" << std::endl;
-                break;
+        struct pollfd fds[2] = {{sockCliente, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        int n = poll(fds, tecladoAbierto ? 2 : 1, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error en poll: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (!mostrarDelServidor(sockCliente, tecladoAbierto)) break;
+        }
+        if (tecladoAbierto && (fds[1].revents & (POLLIN | POLLHUP))) {
+            char buffer[BUFFERSIZE];
+            ssize_t leidos = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (leidos < 0 && errno == EINTR) continue;
+            if (leidos <= 0) {
+                // Fin de la entrada: despedirse y esperar a que el servidor cierre
+                tecladoAbierto = false;
+                if (!enviarTodo(sockCliente, "BYE\n")) break;
+                continue;
             }
-            buffer[valread] = '\0';
-            std::cout << buffer;
-            primerMensaje = false;
-            
-        } else {
-            // Pedir mensaje al usuario
-            std::cout << "Mensaje: ";
-            std::string mensajeUsuario;
-            std::getline(std::cin, mensajeUsuario);
-            mensajeUsuario += "\n";  // Añadir newline para consistencia
-            
-            if (mensajeUsuario == "BYE\n") {
-                // Enviar BYE
-                int sent = send(sockCliente, mensajeUsuario.c_str(), mensajeUsuario.length(), 0);
-                if (sent < 0) {
-                    std::cerr << "Error al enviar BYE" << std::endl;
-                    break;
-                }
-                
-                // Recibir respuesta final
-                int valread = read(sockCliente, buffer2, BUFFERSIZE - 1);
-                if (valread < 0) {
-                    std::cerr << "Error al recibir respuesta final" << std::endl;
-                    break;
-                } else if (valread == 0) {
-                    std::cerr << "Servidor cerró la conexión" << std::endl;
-                    break;
-                }
-                buffer2[valread] = '\0';
-                std::cout << buffer2 << std::endl;
-                break;
-                
-            } else {
-                // Enviar mensaje normal
-                int sent = send(sockCliente, mensajeUsuario.c_str(), mensajeUsuario.length(), 0);
-                if (sent < 0) {
+            pendiente.append(buffer, leidos);
+            // Enviar cada línea completa; tras "BYE" solo queda mostrar la despedida
+            size_t fin;
+            while (tecladoAbierto && (fin = pendiente.find('\n')) != std::string::npos) {
+                std::string linea = pendiente.substr(0, fin + 1);
+                pendiente.erase(0, fin + 1);
+                if (!enviarTodo(sockCliente, linea)) {
                     std::cerr << "Error al enviar mensaje" << std::endl;
-                    break;
-                }
-                
-                // Recibir respuesta
-                int valread = read(sockCliente, buffer, BUFFERSIZE - 1);
-                if (valread < 0) {
-                    std::cerr << "Error al recibir respuesta" << std::endl;
-                    break;
-                } else if (valread == 0) {
-                    std::cerr << "Servidor cerró la conexión" << std::endl;
-                    break;
+                    close(sockCliente);
+                    return 1;
                 }
-                buffer[valread] = '\0';
-                std::cout << buffer;
+                if (linea == "BYE\n") tecladoAbierto = false;
             }
         }
     }
 
+    std::cout << std::endl;
     close(sockCliente);
     return 0;
 }
+
+int main(int argc, char const *argv[]) {
+    if (argc < 2)
+        return 0;
+
+    if (std::string(argv[1]) == "--carga") {
+        OpcionesCarga op;
+        if (!leerOpcionesCarga(argc, argv, op)) {
+            mostrarUsoCarga(argv[0]);
+            return 1;
+        }
+        return ejecutarCarga(op);
+    }
+    
+    return ejecutarInteractivo(argv[1]);
+}
@@ -1,866 +1,4288 @@
 //Vicente Castillo y Oscar Montecinos
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <cstring>
 #include <sstream>
 #include <unistd.h>
 #include <algorithm>
-#include <thread>
 #include <atomic>
 #include <vector>
+#include <deque>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
 #include <memory>
 #include <random>
+#include <functional>
+#include <thread>
+#include <cmath>
+#include <fstream>
+#include <charconv>
 
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <cerrno>
 
 #define PORT 8000
 #define BUFFERSIZE 1024
+#define MAX_EVENTOS 256
+#define MAX_IOV 64
+#define MAX_SALIDA_BYTES (256 * 1024)
+#define MAX_MENSAJE (64 * 1024)
+
+using Reloj = std::chrono::steady_clock;
+using IdTemporizador = uint64_t; // (índice del nodo << 32) | generación; 0 = ninguno
+
+// Mensaje de salida inmutable y compartido: una difusión se arma una sola vez
+// y las colas de salida de todos los destinatarios apuntan al mismo buffer.
+using Mensaje = std::shared_ptr<const std::string>;
+
+static Mensaje hacerMensaje(std::string texto) {
+    return std::make_shared<const std::string>(std::move(texto));
+}
+
+// Clase de un mensaje encolado. Con un cliente lento solo el chat se puede
+// descartar o posponer; menús, juegos y avisos del servidor siempre salen.
+enum class TipoMensaje { Control, Chat };
+
+struct Saliente {
+    Mensaje msg;
+    TipoMensaje tipo;
+};
+
+// Qué hacer con un cliente cuya cola de salida pasa la marca alta
+enum class PoliticaLentos {
+    Desconectar,    // se cierra la conexión (defecto)
+    DescartarChat,  // se descartan los mensajes de chat más viejos de la cola
+    PausarChat      // se deja de encolarle chat hasta bajar de la marca baja
+};
+
+// Opciones de línea de comandos (además de <nClientes>)
+struct Configuracion {
+    int inactividadSeg = 900;   // desconexión por inactividad; 0 la desactiva
+    bool emparejarPorRating = false; // RPS PvP: emparejar por rating en vez de por llegada
+    int puertoAdmin = 0;         // estadísticas en 127.0.0.1 (se activa con --admin); 0 = sin puerto
+    std::string banco;           // banco de trivia compilado; vacío = preguntas incorporadas
+    int preguntasTrivia = 4;     // preguntas por partida de trivia
+    int reactores = 1;           // hilos con su propio epoll y socket de escucha
+    bool fijarCpu = false;       // fijar cada reactor a un núcleo
+    bool ioUring = false;        // E/S con io_uring en vez de epoll + read/writev
+    size_t salidaAlta = MAX_SALIDA_BYTES;     // marca alta de la cola de salida por conexión
+    size_t salidaBaja = MAX_SALIDA_BYTES / 4; // marca baja: se reanuda el chat
+    PoliticaLentos lentos = PoliticaLentos::Desconectar;
+    double tasaMensajes = 50;    // chat y /msg por segundo por conexión; 0 = sin límite
+    double tasaMensajesIp = 0;   // chat y /msg por segundo por dirección de origen; 0 = sin límite
+    double tasaConexionesIp = 0; // conexiones nuevas/s por dirección de origen; 0 = sin límite
+    int trabajadores = 2;        // hilos del ejecutor de trabajo diferido; 0 = todo en el reactor
+};
+
+static Configuracion config;
 
 // Contador atómico de clientes activos
 static std::atomic<int> activeClients(0);
 
-// Estructuras para gestionar clientes conectados
-struct ClientInfo {
-    int sock;
-    std::string name;
-    int id;
-    bool inMenu = true;
+// ---------------------------------------------------------------------------
+// Métricas. Cada hilo escribe solo en sus propios contadores (load + store
+// relajados, sin instrucciones con lock ni contención); /stats y el puerto de
+// administración suman los de todos los hilos al momento de leer.
+// ---------------------------------------------------------------------------
+
+// Contador de un solo escritor, legible desde cualquier hilo
+struct Contador {
+    std::atomic<uint64_t> v{0};
+
+    void sumar(uint64_t n = 1) { v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void maximo(uint64_t n) { if (n > leer()) v.store(n, std::memory_order_relaxed); }
+    uint64_t leer() const { return v.load(std::memory_order_relaxed); }
 };
 
-static std::vector<ClientInfo> clients;
-static std::mutex clients_mutex;
+// Histograma de duraciones en cubetas log2 de nanosegundos
+struct Histograma {
+    static constexpr int kCubetas = 40; // la última junta todo lo >= 2^39 ns (~9 min)
+
+    Contador cubetas[kCubetas];
+    Contador suma;
+    Contador max;
 
-// Funciones auxiliares
-void broadcastMessage(const std::string &msg, int exceptSock = -1) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    for (auto &c : clients) {
-        if (c.sock == exceptSock) continue;
-        send(c.sock, msg.c_str(), msg.size(), 0);
+    void registrar(uint64_t ns) {
+        int i = ns ? 64 - __builtin_clzll(ns) : 0;
+        cubetas[std::min(i, kCubetas - 1)].sumar();
+        suma.sumar(ns);
+        max.maximo(ns);
     }
-}
+    void registrar(Reloj::time_point desde) {
+        registrar(std::chrono::duration_cast<std::chrono::nanoseconds>(Reloj::now() - desde).count());
+    }
+};
 
-// Trim helper: remove leading and trailing whitespace
-static std::string trim(const std::string &s) {
-    size_t start = 0;
-    while (start < s.size() && std::isspace((unsigned char)s[start])) start++;
-    size_t end = s.size();
-    while (end > start && std::isspace((unsigned char)s[end-1])) end--;
-    return s.substr(start, end - start);
-}
+enum class Comando { Registro, Chat, Ping, Stats, Trama, IniciarTrivia, RespuestaTrivia, IniciarRPS, JugadaRPS, Privado, Salas, Historial, Bye, Cuenta };
+static const char *const nombresComando[] = {
+    "registro", "chat", "/ping", "/stats", "/trama", "/juego_trivia", "respuesta trivia",
+    "/piedra_papel_tijera", "jugada RPS", "/msg", "salas", "/history", "BYE"
+};
 
-std::string getClientNameById(int id) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    for (auto &c : clients) if (c.id == id) return c.name;
-    return std::string("Desconocido");
-}
+// Comando en curso en este hilo: mensajeMenu lo precisa para las métricas
+static thread_local Comando comandoActual = Comando::Chat;
 
-int getClientIdBySock(int sock) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    for (auto &c : clients) if (c.sock == sock) return c.id;
-    return -1;
-}
+enum class LockMedido { Registro, Salida, Vaciado, Emparejamiento, Salas, Origenes, Cuenta };
+static const char *const nombresLock[] = {"registro", "salida", "vaciado", "emparejamiento", "salas", "origenes"};
 
-void setClientMenuState(int clientId, bool state) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    for (auto &c : clients) if (c.id == clientId) { c.inMenu = state; break; }
-}
+struct MetricasHilo {
+    Contador mensajesEntrada, bytesEntrada;
+    Contador mensajesSalida, bytesSalida, escrituras; // escrituras = writev o envíos al anillo
+    Contador llamadasES;                               // epoll_wait/read/writev o io_uring_enter
+    Contador sinBuffers;                               // recepciones io_uring sin buffer libre
+    Contador lentosDesconectados, pausasChat, chatOmitido; // política de clientes lentos
+    Contador limitadosConexion, limitadosOrigen;       // mensajes descartados por límite de tasa
+    Contador rechazadasOrigen, rechazadasLleno;        // conexiones rechazadas al aceptar
+    Contador tareas, tareasRobadas, tareasEnLlamador;  // ejecutor de trabajo diferido
+    Contador difusiones, destinatarios;
+    Contador buffersTomados, buffersReusados, buffersDevueltos; // pool de E/S
+    Histograma difusion;                               // tiempo de fan-out completo
+    Histograma comandos[(int)Comando::Cuenta];
+    Contador adquisiciones[(int)LockMedido::Cuenta];
+    Histograma esperaLock[(int)LockMedido::Cuenta];    // solo adquisiciones con espera
+};
 
-void setAllClientsMenuState(bool state) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    for (auto &c : clients) c.inMenu = state;
-}
+static std::mutex metricas_mutex;
+static std::deque<MetricasHilo> metricasHilos; // deque: direcciones estables
 
-void sendMenuToClient(int sock) {
-    std::string menu = "Menu principal - comandos disponibles:\n";
-    menu += "/juego_trivia -> iniciar trivia (global)\n";
-    menu += "/piedra_papel_tijera -> jugar RPS (vs maquina o vs jugador)\n";
-    menu += "Para chatear aquí, debe haber exactamente 2 usuarios conectados; de lo contrario use un comando.\n";
-    send(sock, menu.c_str(), menu.size(), 0);
-}
-
-// Trivia game state
-static std::atomic<bool> triviaActive(false);
-static std::atomic<bool> questionActive(false);
-static std::string currentAnswer;
-static std::atomic<bool> answered(false);
-static std::mutex trivia_mutex;
-static std::map<int,int> triviaScores; // clientId -> score
-static int triviaLastResponder = -1;
-
-// Trivia: preguntas simples (pregunta, respuesta)
-static const std::vector<std::pair<std::string,std::string>> triviaQuestions = {
-    {"¿Nombre del juego de Kratos?", "God of War"},
-    {"¿Primer Call of Duty con Zombies?", "World at War"},
-    {"¿Personaje con bigote de nintendo?", "Mario"},
-    {"¿Color del traje de link tradicional?", "verde"}
-};
-
-void triviaThread() {
-    {
-        std::lock_guard<std::mutex> lock(trivia_mutex);
-        if (triviaActive.load()) return; // ya activo
-        triviaActive = true;
-        triviaScores.clear();
-        // marcar a todos los clientes como fuera del menu (en juego)
-        setAllClientsMenuState(false);
-        // inicializar puntajes actuales
-        std::lock_guard<std::mutex> lock2(clients_mutex);
-        for (auto &c : clients) triviaScores[c.id] = 0;
+static MetricasHilo &metricas() {
+    thread_local MetricasHilo *propias = nullptr;
+    if (!propias) {
+        std::lock_guard<std::mutex> lock(metricas_mutex);
+        propias = &metricasHilos.emplace_back();
     }
+    return *propias;
+}
 
-    // Enviar reglas básicas de la trivia
-    {
-        std::ostringstream rules;
-        rules << "Inicia Trivia! Responde lo más rápido posible.\n";
-        rules << "Reglas: " << triviaQuestions.size() << " preguntas. El primer jugador en enviar la respuesta correcta obtiene 1 punto por pregunta.\n";
-        rules << "Tiempo por pregunta: 10 segundos.\n";
-        broadcastMessage(rules.str());
+// Toma el mutex midiendo la espera solo cuando está ocupado
+template <class M>
+static std::unique_lock<M> bloquear(M &m, LockMedido cual) {
+    MetricasHilo &mh = metricas();
+    mh.adquisiciones[(int)cual].sumar();
+    std::unique_lock<M> lock(m, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        auto inicio = Reloj::now();
+        lock.lock();
+        mh.esperaLock[(int)cual].registrar(inicio);
     }
+    return lock;
+}
 
-    for (auto &q : triviaQuestions) {
-        std::string originalAnswer = q.second;
-        // normalize answer to lower-case trimmed for comparison
-        std::string norm = q.second;
-        while (!norm.empty() && (norm.back() == '\n' || norm.back() == '\r' || norm.back()==' ')) norm.pop_back();
-        while (!norm.empty() && (norm.front()==' ')) norm.erase(norm.begin());
-        std::transform(norm.begin(), norm.end(), norm.begin(), ::tolower);
-
-        {
-            std::lock_guard<std::mutex> lock(trivia_mutex);
-            currentAnswer = norm;
-            answered = false;
-            triviaLastResponder = -1;
-            questionActive = true;
-        }
+// Niveles (no contadores): se leen directamente al armar el reporte
+static std::atomic<int64_t> bytesEnColas(0);
+static std::atomic<int> partidasPvP(0);
 
-        std::string pregunta = std::string("Pregunta: ") + q.first + "\n";
-        broadcastMessage(pregunta);
+struct PvPGame;
+struct TicketEmparejamiento;
+struct Sala;
+struct SesionTrivia;
+struct Reactor;
+struct OperacionIO;
 
-        // Habilitar la escritura para respuestas y esperar hasta 10 segundos o hasta que alguien responda
-        {
-            std::lock_guard<std::mutex> lock(trivia_mutex);
-            questionActive = true;
-            answered = false;
-            triviaLastResponder = -1;
-        }
+// Estado de cada conexión dentro del reactor. Reemplaza las variables locales
+// que antes vivían en la pila del hilo de cada cliente.
+enum class EstadoConexion {
+    EsperandoNombre,
+    Menu,                 // bucle principal: comandos, chat y respuestas de trivia
+    EligiendoModoRPS,
+    RPSMaquinaMovimiento,
+    RPSMaquinaRevancha,
+    RPSEsperandoRival,
+    RPSJugador
+};
 
-        // Informar a los clientes que tienen 10 segundos para responder
-        broadcastMessage("Escribe tu respuesta ahora (10s)\n");
+// Delimitación de los mensajes que envía el cliente
+enum class ModoTrama {
+    Lineas,     // mensajes terminados en '\n' (por defecto)
+    Longitud    // prefijo de 4 bytes big-endian con el largo del mensaje
+};
 
-        const int timeoutMs = 10000;
-        const int stepMs = 100;
-        int waited = 0;
-        while (waited < timeoutMs) {
-            if (answered.load()) break;
-            std::this_thread::sleep_for(std::chrono::milliseconds(stepMs));
-            waited += stepMs;
-        }
+// Pool de buffers de E/S en clases de tamaño potencia de dos, desde
+// BUFFERSIZE hasta lo que ocupa el mensaje más largo. Los bloques devueltos
+// quedan en una lista libre por clase y se reusan sin malloc ni memset; cada
+// lista retiene a lo más kBytesLibres para no acaparar memoria tras un pico.
+// Un pool por hilo: no necesita lock (un bloque puede volver a otro hilo).
+class PoolBuffers {
+public:
+    ~PoolBuffers() {
+        for (auto &lista : libres)
+            for (char *p : lista) ::operator delete(p);
+    }
 
-        {
-            std::lock_guard<std::mutex> lock(trivia_mutex);
-            questionActive = false;
+    // Bloque de al menos `minimo` bytes; `tam` recibe su tamaño real
+    char *tomar(size_t minimo, size_t &tam) {
+        int clase = claseDe(minimo);
+        tam = tamanoClase(clase);
+        MetricasHilo &m = metricas();
+        m.buffersTomados.sumar();
+        if (clase < kClases && !libres[clase].empty()) {
+            char *p = libres[clase].back();
+            libres[clase].pop_back();
+            m.buffersReusados.sumar();
+            return p;
         }
+        return static_cast<char *>(::operator new(tam));
+    }
 
-        // anunciar resultado (si alguien respondió, lo hizo antes y triviaLastResponder está seteado)
-        if (answered.load() && triviaLastResponder != -1) {
-            std::string quien = getClientNameById(triviaLastResponder);
-            std::string msg = "Respuesta correcta de: " + quien + " (" + originalAnswer + ")\n";
-            broadcastMessage(msg);
-        } else {
-            std::string correcta = std::string("Respuesta correcta: ") + originalAnswer + "\n";
-            broadcastMessage(correcta);
-            broadcastMessage("Nadie respondió correctamente en tiempo.\n");
-        }
-        // breve pausa antes de la siguiente pregunta
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    void devolver(char *p, size_t tam) {
+        metricas().buffersDevueltos.sumar();
+        int clase = claseDe(tam);
+        if (clase < kClases && libres[clase].size() * tam < kBytesLibres) libres[clase].push_back(p);
+        else ::operator delete(p);
     }
 
-    // Resultado final
-    std::string resultsStr;
-    {
-        std::ostringstream oss;
-        oss << "Resultados de la Trivia:\n";
-        // Lock trivia mutex first then clients to avoid deadlocks (consistent order)
-        std::lock_guard<std::mutex> lockt(trivia_mutex);
-        std::lock_guard<std::mutex> lockc(clients_mutex);
-        for (auto &c : clients) {
-            int s = 0;
-            if (triviaScores.count(c.id)) s = triviaScores[c.id];
-            oss << c.name << ": " << s << "\n";
-        }
-        resultsStr = oss.str();
+private:
+    static constexpr int kClases = 8;                      // BUFFERSIZE .. BUFFERSIZE << 7
+    static constexpr size_t kBytesLibres = 4 * 1024 * 1024; // por clase
+    static_assert((size_t(BUFFERSIZE) << (kClases - 1)) >= MAX_MENSAJE + 4, "el mensaje más largo debe caber en una clase");
+
+    std::vector<char *> libres[kClases];
+
+    static int claseDe(size_t n) {
+        int clase = 0;
+        while (tamanoClase(clase) < n) clase++;
+        return clase;
     }
-    // Broadcast fuera de locks
-    broadcastMessage(resultsStr);
+    static size_t tamanoClase(int clase) { return size_t(BUFFERSIZE) << clase; }
+};
 
-    // Avisar que la partida terminó y devolver al menu principal
-    broadcastMessage("partida terminada, volviendo al menu principal\n");
+static PoolBuffers &poolBuffers() {
+    thread_local PoolBuffers pool;
+    return pool;
+}
 
-    // Preparar lista de sockets y luego enviar menús fuera del lock
-    std::vector<int> clientSocks;
-    {
-        std::lock_guard<std::mutex> lock(clients_mutex);
-        for (auto &c : clients) clientSocks.push_back(c.sock);
+// Buffer de entrada por conexión, con bloques del pool. Se lee directo a su
+// cola y los mensajes se entregan como vistas sobre él, sin copiarlos. Cuando
+// queda vacío devuelve el bloque: una conexión inactiva no retiene memoria.
+struct BufferEntrada {
+    char *datos = nullptr;
+    size_t capacidad = 0;
+    size_t inicio = 0;   // primer byte sin consumir
+    size_t fin = 0;      // fin de los datos recibidos
+
+    BufferEntrada() = default;
+    BufferEntrada(const BufferEntrada &) = delete;
+    BufferEntrada &operator=(const BufferEntrada &) = delete;
+    ~BufferEntrada() { soltar(); }
+
+    std::string_view pendiente() const {
+        return std::string_view(datos + inicio, fin - inicio);
     }
 
-    // Marcar trivia como inactiva antes de enviar menús
-    triviaActive = false;
-    setAllClientsMenuState(true);
+    // Deja al menos `minimo` bytes libres al final (compactando o creciendo)
+    char *espacio(size_t minimo, size_t &libre) {
+        if (capacidad - fin < minimo && inicio > 0) {
+            std::memmove(datos, datos + inicio, fin - inicio);
+            fin -= inicio;
+            inicio = 0;
+        }
+        if (capacidad - fin < minimo) {
+            size_t nuevaCapacidad;
+            char *nuevo = poolBuffers().tomar(std::max(capacidad * 2, fin + minimo), nuevaCapacidad);
+            if (fin) std::memcpy(nuevo, datos, fin);
+            if (datos) poolBuffers().devolver(datos, capacidad);
+            datos = nuevo;
+            capacidad = nuevaCapacidad;
+        }
+        libre = capacidad - fin;
+        return datos + fin;
+    }
 
-    for (int s : clientSocks) sendMenuToClient(s);
-}
+    void escrito(size_t n) { fin += n; }
 
-// Forward declarations for functions used before their definitions
-void piedrapapeltijeras(int sockCliente);
-void tivia(int sockCliente);
-void playRPSvsMachine(int sockCliente, const std::string &nombre);
-void playRPSvsPlayer(int sockCliente, const std::string &nombre, int clientId);
-void manejarCliente(int sockCliente, int clientId);
+    // Las vistas entregadas siguen siendo válidas hasta el próximo espacio()
+    void consumir(size_t n) {
+        inicio += n;
+        if (inicio == fin) inicio = fin = 0;
+    }
 
-void crearSocket(int &sock) {
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {        
-        std::cerr << "Error Creación de Socket" << std::endl;
-        exit(1);
+    // Devuelve el bloque al pool si no queda nada por procesar
+    void soltarSiVacio() {
+        if (fin == 0) soltar();
     }
-}
 
-void configurarServidor(int socket, struct sockaddr_in &conf) {
-    // Asegurar que la estructura esté inicializada a cero
-    std::memset(&conf, 0, sizeof(conf));
-    // Permitir reusar la dirección rápidamente (evita EADDRINUSE en reinicios rápidos)
-    int opt = 1;
-    if (setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        std::cerr << "Warning: setsockopt(SO_REUSEADDR) falló: " << std::strerror(errno) << std::endl;
+private:
+    void soltar() {
+        if (datos) poolBuffers().devolver(datos, capacidad);
+        datos = nullptr;
+        capacidad = inicio = fin = 0;
     }
-    conf.sin_family = AF_INET;
-    conf.sin_addr.s_addr = htonl(INADDR_ANY);
-    conf.sin_port = htons(PORT);
+};
 
-    if ((bind(socket, (struct sockaddr *)&conf, sizeof(conf))) < 0) {
-        std::cerr << "Error de enlace: " << std::strerror(errno) << std::endl;
-        exit(1);
+// Límite de tasa: 'tasa' fichas por segundo con ráfagas de hasta
+// kSegundosRafaga segundos. Un cubo nuevo empieza lleno.
+static constexpr double kSegundosRafaga = 2;
+
+struct CuboTokens {
+    double fichas = -1;
+    Reloj::time_point ultimo;
+
+    bool tomar(double tasa, Reloj::time_point ahora) {
+        double capacidad = std::max(1.0, tasa * kSegundosRafaga);
+        fichas = (fichas < 0 ? capacidad : std::min(capacidad, fichas + tasa * std::chrono::duration<double>(ahora - ultimo).count()));
+        ultimo = ahora;
+        if (fichas < 1) return false;
+        fichas -= 1;
+        return true;
     }
-}
 
-void escucharClientes(int sock, int n) {
-    if (listen(sock, n) < 0) {
-        std::cerr << "Error listening" << std::endl;
-        exit(1);
+    // Ya se habría rellenado del todo: olvidarlo no cambia nada
+    bool lleno(double tasa, Reloj::time_point ahora) const {
+        return fichas < 0 || tasa <= 0 || ahora - ultimo >= std::chrono::duration<double>(kSegundosRafaga);
     }
-}
+};
 
-void aceptarConexion(int &sockNuevo, int sock, struct sockaddr_in &conf) {
-    socklen_t tamannoConf = sizeof(conf);
+// Cupos compartidos por todas las conexiones de una dirección de origen
+struct OrigenCliente {
+    std::mutex mutex;
+    CuboTokens mensajes, conexiones;
+};
 
-    if ((sockNuevo = accept(sock, (struct sockaddr *)&conf, &tamannoConf)) < 0) {
-        std::cerr << "Error accepting" << std::endl;
-        exit(1);
+// Cupos por dirección de origen (IPv4), repartidos en fragmentos con su
+// propio lock para que los reactores no compitan. Una entrada vive mientras
+// alguna conexión la referencia; las demás se olvidan cuando su cubo ya se
+// habría rellenado, así que la tabla no crece con direcciones de paso.
+class TablaOrigenes {
+public:
+    std::shared_ptr<OrigenCliente> buscar(uint32_t ip, Reloj::time_point ahora) {
+        Fragmento &f = fragmentos[ip % kFragmentos];
+        auto lock = bloquear(f.mutex, LockMedido::Origenes);
+        auto &origen = f.porIp[ip];
+        if (!origen) {
+            origen = std::make_shared<OrigenCliente>();
+            if (f.porIp.size() > f.limpiarEn) limpiar(f, ahora);
+        }
+        return origen;
     }
-}
 
-void seleccionjuego(int sockCliente) {
-    char buffer[BUFFERSIZE] = {0};
-    int valread = read(sockCliente, buffer, BUFFERSIZE - 1);
-    if (valread < 0) {
-        std::cerr << "Error al recibir selección de juego" << std::endl;
-        return;
-    } else if (valread == 0) {
-        std::cerr << "Cliente cerró la conexión" << std::endl;
-        return;
+    size_t tamanno() {
+        size_t n = 0;
+        for (auto &f : fragmentos) {
+            std::lock_guard<std::mutex> lock(f.mutex);
+            n += f.porIp.size();
+        }
+        return n;
     }
-    buffer[valread] = '\0';
-    std::string seleccion(buffer);
 
-    if (seleccion == "1\n") {
-        piedrapapeltijeras(sockCliente);
-    } else if (seleccion == "2\n") {
-        tivia(sockCliente);
-    } else {
-        // Si no es una selección de juego válida, asumimos protocolo de ChatP3.
-        // El cliente envió su nombre (sin newline). Responderemos con un saludo
-        // y luego entramos en un bucle de eco hasta recibir "BYE".
-        std::string nombre = seleccion;
-        // Eliminar posibles '\r' y '\n' al final
-        while (!nombre.empty() && (nombre.back() == '\n' || nombre.back() == '\r'))
-            nombre.pop_back();
-
-        std::string bienvenida = "Bienvenido " + nombre + "\n";
-        send(sockCliente, bienvenida.c_str(), bienvenida.size(), 0);
-
-        // Bucle de chat: leer mensajes y responder hasta BYE
-        while (true) {
-            char buf[BUFFERSIZE] = {0};
-            int n = read(sockCliente, buf, BUFFERSIZE - 1);
-            if (n < 0) {
-                std::cerr << "Error leyendo mensaje del cliente" << std::endl;
-                break;
-            } else if (n == 0) {
-                std::cerr << "Cliente cerró la conexión" << std::endl;
-                break;
-            }
-            buf[n] = '\0';
-            std::string msg(buf);
+private:
+    static constexpr size_t kFragmentos = 16;
+    static constexpr size_t kMinimoLimpieza = 1024;
 
-            // Normalizar el mensaje para comparación
-            std::string msg_trim = msg;
-            while (!msg_trim.empty() && (msg_trim.back() == '\n' || msg_trim.back() == '\r'))
-                msg_trim.pop_back();
+    struct Fragmento {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, std::shared_ptr<OrigenCliente>> porIp;
+        size_t limpiarEn = kMinimoLimpieza;
+    };
 
-            if (msg_trim == "BYE") {
-                std::string despedida = "Adios " + nombre + "\n";
-                send(sockCliente, despedida.c_str(), despedida.size(), 0);
-                break;
-            } else {
-                // Responder con eco (o cualquier lógica de servidor)
-                std::string respuesta = "Servidor: " + msg;
-                send(sockCliente, respuesta.c_str(), respuesta.size(), 0);
+    // Barrido amortizado: se repite cuando el fragmento duplica lo que sobrevivió
+    static void limpiar(Fragmento &f, Reloj::time_point ahora) {
+        for (auto it = f.porIp.begin(); it != f.porIp.end();) {
+            OrigenCliente &o = *it->second;
+            bool olvidar = false;
+            if (it->second.use_count() == 1) {
+                std::lock_guard<std::mutex> lock(o.mutex);
+                olvidar = o.mensajes.lleno(config.tasaMensajesIp, ahora) &&
+                          o.conexiones.lleno(config.tasaConexionesIp, ahora);
             }
+            it = (olvidar ? f.porIp.erase(it) : std::next(it));
         }
+        f.limpiarEn = std::max(kMinimoLimpieza, f.porIp.size() * 2);
     }
-}
 
-void piedrapapeltijeras(int sockCliente) {
-    // Implementar la lógica del juego aquí. Por ahora solo enviamos un mensaje
-    std::string msg = "PiedraPapelTijeras: función no implementada\n";
-    send(sockCliente, msg.c_str(), msg.size(), 0);
-}
+    Fragmento fragmentos[kFragmentos];
+};
 
-void tivia(int sockCliente)   {
-    // Implementar la lógica del juego aquí. Por ahora solo enviamos un mensaje
-    std::string msg = "Trivia: función no implementada\n";
-    send(sockCliente, msg.c_str(), msg.size(), 0);
-}
+static TablaOrigenes origenes;
 
-// Thread function to handle a connected client
-// Piedra-Papel-Tijera structures
-struct PvPGame {
-    int player1Id = -1;
-    int player2Id = -1;
-    int player1Sock = -1;
-    int player2Sock = -1;
-    std::string player1Name;
-    std::string player2Name;
-    std::string move1;
-    std::string move2;
-    bool ready1 = false;
-    bool ready2 = false;
-    bool resultSent = false;
-    bool replay1 = false;
-    bool replay2 = false;
-    bool hasReplay1 = false;
-    bool hasReplay2 = false;
-    std::mutex mtx;
-    std::condition_variable cv;
+struct Conexion : std::enable_shared_from_this<Conexion> {
+    int sock = -1;
+    int id = -1;
+    std::string nombre;
+    bool registrado = false;
+    EstadoConexion estado = EstadoConexion::EsperandoNombre;
+    int intentos = 0;                     // intentos inválidos en RPS vs máquina
+    std::shared_ptr<PvPGame> partida;     // partida PvP en curso
+    std::shared_ptr<TicketEmparejamiento> ticket; // en la cola de emparejamiento
+    int jugador = 0;                      // índice dentro de la partida PvP (0 o 1)
+    int rating = 1000;                    // Elo de RPS PvP
+    std::shared_ptr<Sala> sala;           // sala actual, desde el registro (solo reactor)
+    std::atomic<bool> cerrando{false};    // se libera al final de la iteración del reactor; otros reactores lo consultan
+    std::atomic<Reactor *> dueno{nullptr}; // reactor que la atiende; solo cambia al traspasarla
+    OperacionIO *recepcion = nullptr;     // io_uring: recv multishot armado
+    size_t enVuelo = 0;                   // io_uring: mensajes del frente de la cola en un envío
+    Reactor *traspasoA = nullptr;         // io_uring: traspaso esperando las operaciones en vuelo
+    std::function<void(Conexion &)> alTraspasar;
+    std::atomic<bool> inMenu{true};       // se consulta sin lock desde cualquier hilo
+    BufferEntrada entrada;
+    ModoTrama trama = ModoTrama::Lineas;
+    Reloj::time_point ultimaActividad;    // último dato recibido
+    CuboTokens cupoMensajes;              // límite de mensajes de esta conexión (solo reactor)
+    std::shared_ptr<OrigenCliente> origen; // límites de su dirección; nulo si no hay por dirección
+    bool limitada = false;                // ya se le avisó que se descartan sus mensajes
+    IdTemporizador inactividad = 0;       // revisión de inactividad en la rueda
+    IdTemporizador nombreSinFin = 0;      // compatibilidad: nombre sin '\n' esperando más datos
+
+    // Cola de salida acotada. Cualquier hilo puede encolar; solo el reactor la
+    // vacía con writev cuando el socket acepta datos.
+    std::mutex salida_mutex;
+    std::deque<Saliente> salida;
+    size_t offsetSalida = 0;              // bytes ya enviados del primer mensaje
+    size_t bytesSalida = 0;               // bytes pendientes en la cola
+    size_t bytesChat = 0;                 // de ellos, en mensajes de chat
+    size_t bytesRechazados = 0;           // de ellos, los que el socket no aceptó al intentar vaciar
+    uint64_t iteracionEnvio = 0;          // io_uring: iteración del reactor en que salió el envío
+    bool chatPausado = false;             // PausarChat: pasó la marca alta y aún no bajó de la baja
+    size_t chatOmitido = 0;               // mensajes de chat no entregados desde el último aviso
+    bool programada = false;              // ya está en la lista de vaciado del reactor
+    bool cerrada = false;                 // socket cerrado: se descartan los envíos
+    bool fallida = false;                 // error de escritura o cliente lento desconectado
+};
+
+// Registro de clientes conectados, indexado por id, socket y nombre.
+// Es inmutable una vez publicado (copy-on-write): los lectores toman el
+// snapshot vigente sin lock y los escritores (altas/bajas) publican uno nuevo.
+struct RegistroClientes {
+    std::vector<std::shared_ptr<Conexion>> lista;   // orden de llegada
+    std::unordered_map<int, std::shared_ptr<Conexion>> porId;
+    std::unordered_map<int, std::shared_ptr<Conexion>> porSock;
+    std::unordered_map<std::string, std::shared_ptr<Conexion>> porNombre;
 };
 
-static std::shared_ptr<PvPGame> waitingGame = nullptr;
-static std::mutex waiting_mutex;
+static std::shared_ptr<const RegistroClientes> registro = std::make_shared<RegistroClientes>();
+static std::mutex registro_mutex; // solo serializa a los escritores
 
-// Normaliza el movimiento (minúsculas) y acepta varias formas
-std::string normalizeMove(const std::string &m) {
-    std::string s = trim(m);
-    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
-    if (s == "piedra" || s == "p") return "piedra";
-    if (s == "papel" || s == "pa") return "papel";
-    if (s == "tijera" || s == "tijeras" || s == "t") return "tijera";
-    return s;
+static std::shared_ptr<const RegistroClientes> leerRegistro() {
+    return std::atomic_load(&registro);
 }
 
-// Decide ganador: 0 empate, 1 player1 gana, 2 player2 gana
-int decideRPS(const std::string &a, const std::string &b) {
-    if (a == b) return 0;
-    if (a == "piedra" && b == "tijera") return 1;
-    if (a == "tijera" && b == "papel") return 1;
-    if (a == "papel" && b == "piedra") return 1;
-    return 2;
+// Da de alta al cliente si su nombre está libre. Comprobar y publicar bajo el
+// mismo lock garantiza nombres únicos aunque dos registros compitan.
+static bool registrarEnIndice(const std::shared_ptr<Conexion> &c) {
+    auto lock = bloquear(registro_mutex, LockMedido::Registro);
+    if (registro->porNombre.count(c->nombre)) return false;
+    auto nuevo = std::make_shared<RegistroClientes>(*registro);
+    nuevo->lista.push_back(c);
+    nuevo->porId[c->id] = c;
+    nuevo->porSock[c->sock] = c;
+    nuevo->porNombre[c->nombre] = c;
+    std::atomic_store(&registro, std::shared_ptr<const RegistroClientes>(std::move(nuevo)));
+    return true;
 }
 
-// Juego vs máquina
-void playRPSvsMachine(int sockCliente, const std::string &nombre) {
-    // marcar cliente como en juego (fuera del menu)
-    int cid = getClientIdBySock(sockCliente);
-    if (cid != -1) setClientMenuState(cid, false);
-    const int maxAttempts = 5;
-    std::string move;
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<int> dist(0,2);
-
-    while (true) {
-        std::string prompt = "Elegiste jugar contra la máquina. Envía 'piedra', 'papel' o 'tijera' (o escribe CANCEL para salir)\n";
-        int attempts = 0;
-        move.clear();
-
-        while (attempts < maxAttempts) {
-            send(sockCliente, prompt.c_str(), prompt.size(), 0);
-            char buf[BUFFERSIZE] = {0};
-            int n = read(sockCliente, buf, BUFFERSIZE - 1);
-            if (n <= 0) {
-                // cliente desconectó
-                if (cid != -1) setClientMenuState(cid, true);
-                return;
-            }
-            buf[n] = '\0';
-            std::string raw(buf);
-            raw = trim(raw);
-            std::string rawLower = raw;
-            std::transform(rawLower.begin(), rawLower.end(), rawLower.begin(), ::tolower);
-            if (rawLower == "cancel") {
-                send(sockCliente, "Partida cancelada por el usuario.\n", 33, 0);
-                if (cid != -1) {
-                    setClientMenuState(cid, true);
-                    sendMenuToClient(sockCliente);
-                }
-                return;
-            }
-            move = normalizeMove(raw);
-            if (move == "piedra" || move == "papel" || move == "tijera") break;
-            std::string inval = "Movimiento inválido. Intenta de nuevo o escribe CANCEL para salir.\n";
-            send(sockCliente, inval.c_str(), inval.size(), 0);
-            attempts++;
-        }
-
-        if (!(move == "piedra" || move == "papel" || move == "tijera")) {
-            send(sockCliente, "No se recibió un movimiento válido. Se cancela la partida.\n", 50, 0);
-            if (cid != -1) {
-                setClientMenuState(cid, true);
-                sendMenuToClient(sockCliente);
-            }
-            return;
-        }
-
-        // Generar movimiento de la máquina
-        int r = dist(gen);
-        std::string machine = (r==0?"piedra":(r==1?"papel":"tijera"));
+static void quitarDelIndice(const Conexion &c) {
+    auto lock = bloquear(registro_mutex, LockMedido::Registro);
+    auto nuevo = std::make_shared<RegistroClientes>(*registro);
+    nuevo->lista.erase(std::remove_if(nuevo->lista.begin(), nuevo->lista.end(),
+                                      [&c](const std::shared_ptr<Conexion> &x){ return x.get() == &c; }),
+                       nuevo->lista.end());
+    nuevo->porId.erase(c.id);
+    nuevo->porSock.erase(c.sock);
+    auto it = nuevo->porNombre.find(c.nombre);
+    if (it != nuevo->porNombre.end() && it->second.get() == &c) nuevo->porNombre.erase(it);
+    std::atomic_store(&registro, std::shared_ptr<const RegistroClientes>(std::move(nuevo)));
+}
 
-        int res = decideRPS(move, machine);
-        std::string resultado;
-        if (res == 0) resultado = "Empate! Ambos eligieron " + move + "\n";
-        else if (res == 1) resultado = "Ganaste! Tu " + move + " vence a " + machine + "\n";
-        else resultado = "Perdiste. Tu " + move + " pierde contra " + machine + "\n";
+// Historial de chat de una sala: anillo de capacidad fija que guarda los mismos
+// buffers compartidos que se difundieron, sin copiar texto, así que la memoria
+// queda acotada a kCapacidad mensajes. Quien escribe reserva su ranura con
+// fetch_add. Cada ranura guarda en línea el número de escritura que la ocupa y
+// el buffer, bajo un cerrojo de un bit propio que solo dura lo que copiar un
+// shared_ptr. No hay lock compartido (std::atomic_load sobre shared_ptr usa el
+// banco global de mutex de libstdc++) ni una reserva de memoria por mensaje;
+// solo chocan dos hilos que tocan la misma ranura a la vez.
+class HistorialSala {
+public:
+    static constexpr size_t kCapacidad = 64;
 
-        send(sockCliente, resultado.c_str(), resultado.size(), 0);
-        // Anunciar resultado a la sala (RPS vs máquina)
-        {
-            std::string summary = "RPS - ";
-            summary += nombre + " (" + move + ") vs Máquina (" + machine + "): ";
-            if (res == 0) summary += "Empate\n";
-            else if (res == 1) summary += nombre + " gana\n";
-            else summary += "Máquina gana\n";
-            broadcastMessage(summary);
-        }
-
-        if (res == 0) {
-            // Empate: ofrecer volver a jugar
-            std::string ask = "Empate! ¿Jugar otra ronda? (si/no)\n";
-            send(sockCliente, ask.c_str(), ask.size(), 0);
-            char rb[BUFFERSIZE] = {0};
-            int rn = read(sockCliente, rb, BUFFERSIZE - 1);
-            if (rn <= 0) {
-                if (cid != -1) setClientMenuState(cid, true);
-                return;
-            }
-            rb[rn] = '\0';
-            std::string ans(rb);
-            while (!ans.empty() && (ans.back()=='\n' || ans.back()=='\r')) ans.pop_back();
-            std::transform(ans.begin(), ans.end(), ans.begin(), ::tolower);
-            if (ans == "si" || ans == "s" || ans == "yes" || ans == "y") {
-                // continuar lazo y jugar otra ronda
-                continue;
-            } else {
-                std::string endmsg = "partida terminada, volviendo al menu principal\n";
-                send(sockCliente, endmsg.c_str(), endmsg.size(), 0);
-                if (cid != -1) {
-                    setClientMenuState(cid, true);
-                    sendMenuToClient(sockCliente);
-                }
-                return;
-            }
-        } else {
-            // Win or lose: finalizar y volver al menu
-            std::string endmsg = "partida terminada, volviendo al menu principal\n";
-            send(sockCliente, endmsg.c_str(), endmsg.size(), 0);
-            if (cid != -1) {
-                setClientMenuState(cid, true);
-                sendMenuToClient(sockCliente);
-            }
-            return;
+    void agregar(const Mensaje &msg) {
+        uint64_t n = escritos.fetch_add(1, std::memory_order_acq_rel);
+        Ranura &r = ranuras[n % kCapacidad];
+        Mensaje anterior;
+        r.tomar();
+        // Una escritura rezagada de la vuelta anterior no pisa a una más nueva
+        if (!r.msg || r.seq < n) {
+            anterior = std::move(r.msg);
+            r.seq = n;
+            r.msg = msg;
         }
+        r.soltar();
+        // 'anterior' se libera aquí, fuera del cerrojo
     }
-}
 
-void playRPSvsPlayer(int sockCliente, const std::string &nombre, int clientId) {
-    std::shared_ptr<PvPGame> mygame;
-    {
-        std::lock_guard<std::mutex> lock(waiting_mutex);
-        if (!waitingGame) {
-            // No one is waiting, create a new game
-            waitingGame = std::make_shared<PvPGame>();
-            waitingGame->player1Id = clientId;
-            waitingGame->player1Sock = sockCliente;
-            waitingGame->player1Name = nombre;
-            mygame = waitingGame;
-        } else {
-            // Someone is waiting, join their game
-            mygame = waitingGame;
-            waitingGame = nullptr; // Clear the waiting game
-            mygame->player2Id = clientId;
-            mygame->player2Sock = sockCliente;
-            mygame->player2Name = nombre;
-        }
-    }
-
-    if (mygame->player2Id == -1) {
-        // I am the first player, wait for the second
-        send(sockCliente, "Esperando rival...\n", 20, 0);
-        std::unique_lock<std::mutex> lk(mygame->mtx);
-        if (!mygame->cv.wait_for(lk, std::chrono::seconds(30), [&]{ return mygame->player2Id != -1; })) {
-            // Timeout
-            send(sockCliente, "Nadie se unió. Volviendo al menú.\n", 35, 0);
-            setClientMenuState(clientId, true);
-            sendMenuToClient(sockCliente);
-            waitingGame = nullptr; // Clear the waiting game
-            return;
+    // Los últimos n mensajes, del más viejo al más nuevo
+    std::vector<Mensaje> ultimos(size_t n) const {
+        uint64_t fin = escritos.load(std::memory_order_acquire);
+        uint64_t cuantos = std::min<uint64_t>(std::min<uint64_t>(n, kCapacidad), fin);
+        std::vector<Mensaje> lote;
+        lote.reserve(cuantos);
+        for (uint64_t i = fin - cuantos; i < fin; ++i) {
+            // Una ranura reservada pero aún sin publicar conserva el mensaje de
+            // la vuelta anterior (o ya lo pisó una escritura posterior): si su
+            // número no es i, no es el mensaje buscado y se omite
+            Ranura &r = ranuras[i % kCapacidad];
+            r.tomar();
+            if (r.msg && r.seq == i) lote.push_back(r.msg);
+            r.soltar();
         }
-    } else {
-        // I am the second player, notify the first
-        mygame->cv.notify_all();
+        return lote;
     }
 
-    // Both players are matched
-    setClientMenuState(mygame->player1Id, false);
-    setClientMenuState(mygame->player2Id, false);
-
-    // Game logic here
-    // Each player sends their move, we determine the winner, etc.
-    // For now, let's just simulate one round:
+private:
+    struct Ranura {
+        std::atomic<bool> ocupada{false};
+        uint64_t seq = 0;                 // número de escritura que ocupa la ranura
+        Mensaje msg;
 
-    while (true) {
-        std::string prompt1 = "Jugador 1 (" + mygame->player1Name + "), elige: piedra, papel o tijera (o escribe CANCEL para salir)\n";
-        send(mygame->player1Sock, prompt1.c_str(), prompt1.size(), 0);
-
-        std::string prompt2 = "Jugador 2 (" + mygame->player2Name + "), elige: piedra, papel o tijera (o escribe CANCEL para salir)\n";
-        send(mygame->player2Sock, prompt2.c_str(), prompt2.size(), 0);
-
-        // Leer movimientos de ambos jugadores
-        for (int i = 0; i < 2; ++i) {
-            char buf[BUFFERSIZE] = {0};
-            int n = read((i == 0 ? mygame->player1Sock : mygame->player2Sock), buf, BUFFERSIZE - 1);
-            if (n <= 0) {
-                // cliente desconectó
-                if (i == 0) {
-                    // Player 1 disconnected
-                    send(mygame->player2Sock, "El jugador 1 se ha desconectado. Fin del juego.\n", 45, 0);
-                } else {
-                    // Player 2 disconnected
-                    send(mygame->player1Sock, "El jugador 2 se ha desconectado. Fin del juego.\n", 45, 0);
-                }
-                // Cleanup and exit
-                setClientMenuState(mygame->player1Id, true);
-                setClientMenuState(mygame->player2Id, true);
-                sendMenuToClient(mygame->player1Sock);
-                sendMenuToClient(mygame->player2Sock);
-                return;
-            }
-            buf[n] = '\0';
-            std::string raw(buf);
-            raw = trim(raw);
-            std::string rawLower = raw;
-            std::transform(rawLower.begin(), rawLower.end(), rawLower.begin(), ::tolower);
-            if (rawLower == "cancel") {
-                send(mygame->player1Sock, "Partida cancelada por el usuario.\n", 33, 0);
-                send(mygame->player2Sock, "El otro jugador canceló la partida.\n", 36, 0);
-                // Cleanup and exit
-                setClientMenuState(mygame->player1Id, true);
-                setClientMenuState(mygame->player2Id, true);
-                sendMenuToClient(mygame->player1Sock);
-                sendMenuToClient(mygame->player2Sock);
-                return;
-            }
-            if (i == 0) {
-                mygame->move1 = normalizeMove(raw);
-            } else {
-                mygame->move2 = normalizeMove(raw);
-            }
+        void tomar() {
+            while (ocupada.exchange(true, std::memory_order_acquire))
+                while (ocupada.load(std::memory_order_relaxed)) {}
         }
+        void soltar() { ocupada.store(false, std::memory_order_release); }
+    };
 
-        // Ambos jugadores han hecho su movimiento, determinar ganador
-        int res = decideRPS(mygame->move1, mygame->move2);
-        std::string resultado;
-        if (res == 0) resultado = "Empate! Ambos eligieron " + mygame->move1 + "\n";
-        else if (res == 1) resultado = "Jugador 1 gana! " + mygame->move1 + " vence a " + mygame->move2 + "\n";
-        else resultado = "Jugador 2 gana! " + mygame->move2 + " vence a " + mygame->move1 + "\n";
+    std::atomic<uint64_t> escritos{0};
+    mutable Ranura ranuras[kCapacidad];
+};
 
-        send(mygame->player1Sock, resultado.c_str(), resultado.size(), 0);
-        send(mygame->player2Sock, resultado.c_str(), resultado.size(), 0);
+// Sala de chat con su propio conjunto de miembros. Como el registro, la lista
+// es copy-on-write: difundir la lee sin lock y solo las altas y bajas de esta
+// sala toman su mutex, así que las salas no compiten entre sí y una difusión
+// cuesta lo que mide su sala, no el servidor entero.
+struct Sala {
+    using Miembros = std::vector<std::shared_ptr<Conexion>>;
 
-        // Preguntar si quieren volver a jugar
-        for (int i = 0; i < 2; ++i) {
-            std::string ask = "¿Jugar otra ronda, " + (i == 0 ? mygame->player1Name : mygame->player2Name) + "? (si/no)\n";
-            send((i == 0 ? mygame->player1Sock : mygame->player2Sock), ask.c_str(), ask.size(), 0);
-            char rb[BUFFERSIZE] = {0};
-            int rn = read((i == 0 ? mygame->player1Sock : mygame->player2Sock), rb, BUFFERSIZE - 1);
-            if (rn <= 0) {
-                // cliente desconectó
-                if (i == 0) {
-                    // Player 1 disconnected
-                    send(mygame->player2Sock, "El jugador 1 se ha desconectado. Fin del juego.\n", 45, 0);
-                } else {
-                    // Player 2 disconnected
-                    send(mygame->player1Sock, "El jugador 2 se ha desconectado. Fin del juego.\n", 45, 0);
-                }
-                // Cleanup and exit
-                setClientMenuState(mygame->player1Id, true);
-                setClientMenuState(mygame->player2Id, true);
-                sendMenuToClient(mygame->player1Sock);
-                sendMenuToClient(mygame->player2Sock);
-                return;
-            }
-            rb[rn] = '\0';
-            std::string ans(rb);
-            while (!ans.empty() && (ans.back()=='\n' || ans.back()=='\r')) ans.pop_back();
-            std::transform(ans.begin(), ans.end(), ans.begin(), ::tolower);
-            if (ans != "si" && ans != "s" && ans != "yes" && ans != "y") {
-                std::string endmsg = "partida terminada, volviendo al menu principal\n";
-                send(mygame->player1Sock, endmsg.c_str(), endmsg.size(), 0);
-                send(mygame->player2Sock, endmsg.c_str(), endmsg.size(), 0);
-                setClientMenuState(mygame->player1Id, true);
-                setClientMenuState(mygame->player2Id, true);
-                sendMenuToClient(mygame->player1Sock);
-                sendMenuToClient(mygame->player2Sock);
-                return;
-            }
+    const std::string nombre;
+    std::mutex miembros_mutex;
+    std::shared_ptr<const Miembros> miembros = std::make_shared<Miembros>();
+    bool cerrada = false;                 // quedó vacía y salió del directorio (bajo miembros_mutex)
+    std::shared_ptr<SesionTrivia> trivia; // partida de trivia de la sala (atomic_load/store)
+    HistorialSala historial;
+
+    explicit Sala(std::string nombre) : nombre(std::move(nombre)) {}
+
+    std::shared_ptr<const Miembros> leerMiembros() const { return std::atomic_load(&miembros); }
+    std::shared_ptr<SesionTrivia> triviaActual() const { return std::atomic_load(&trivia); }
+};
+
+// "general" es el lobby: todos entran ahí al registrarse y nunca se borra
+static const char *const kNombreLobby = "general";
+static const std::shared_ptr<Sala> lobby = std::make_shared<Sala>(kNombreLobby);
+
+// Directorio de salas por nombre. Solo se consulta al entrar o salir de una
+// sala (para crearla o borrarla al quedar vacía), nunca al difundir.
+static std::mutex salas_mutex;
+static std::unordered_map<std::string, std::shared_ptr<Sala>> salas{{kNombreLobby, lobby}};
+
+// Saca a la conexión de su sala; la sala se borra del directorio si queda vacía
+static void quitarDeSala(Conexion &c) {
+    std::shared_ptr<Sala> sala = std::move(c.sala);
+    if (!sala) return;
+    bool vacia;
+    {
+        auto lock = bloquear(sala->miembros_mutex, LockMedido::Salas);
+        auto nuevo = std::make_shared<Sala::Miembros>(*sala->miembros);
+        nuevo->erase(std::remove_if(nuevo->begin(), nuevo->end(),
+                                    [&c](const std::shared_ptr<Conexion> &x){ return x.get() == &c; }),
+                     nuevo->end());
+        vacia = nuevo->empty();
+        std::atomic_store(&sala->miembros, std::shared_ptr<const Sala::Miembros>(std::move(nuevo)));
+    }
+    if (!vacia || sala == lobby) return;
+    // Orden de locks: directorio y luego sala. Alguien pudo entrar mientras tanto.
+    auto lockSalas = bloquear(salas_mutex, LockMedido::Salas);
+    auto lock = bloquear(sala->miembros_mutex, LockMedido::Salas);
+    if (!sala->miembros->empty() || sala->cerrada) return;
+    sala->cerrada = true;
+    auto it = salas.find(sala->nombre);
+    if (it != salas.end() && it->second == sala) salas.erase(it);
+}
+
+// Cambia a la conexión de sala, creándola si no existe
+static std::shared_ptr<Sala> entrarASala(Conexion &c, const std::string &nombre) {
+    quitarDeSala(c);
+    for (;;) {
+        std::shared_ptr<Sala> sala;
+        {
+            auto lock = bloquear(salas_mutex, LockMedido::Salas);
+            auto &ranura = salas[nombre];
+            if (!ranura) ranura = std::make_shared<Sala>(nombre);
+            sala = ranura;
         }
-        // Si ambos quieren seguir, continuar el bucle y jugar otra ronda
+        auto lock = bloquear(sala->miembros_mutex, LockMedido::Salas);
+        if (sala->cerrada) continue; // se vació y borró entre ambos locks: buscar de nuevo
+        auto nuevo = std::make_shared<Sala::Miembros>(*sala->miembros);
+        nuevo->push_back(c.shared_from_this());
+        std::atomic_store(&sala->miembros, std::shared_ptr<const Sala::Miembros>(std::move(nuevo)));
+        c.sala = sala;
+        return sala;
     }
 }
 
-void manejarCliente(int sockCliente, int clientId) {
-    std::cout << "Manejando cliente " << clientId << std::endl;
+// Temporizadores del reactor: rueda jerárquica (4 niveles de 256 ranuras,
+// tick de 1 ms). Insertar y cancelar son O(1); los temporizadores lejanos
+// bajan de nivel en cascada a medida que avanza el tiempo. Se ejecutan en el
+// hilo del reactor y epoll_wait duerme justo hasta el próximo vencimiento.
+class RuedaTemporizadores {
+public:
+    RuedaTemporizadores() : origen(Reloj::now()) {
+        for (auto &nivel : ranuras) for (auto &r : nivel) r = kNulo;
+    }
 
-    // Primer read: obtener nombre del cliente
-    char buffer[BUFFERSIZE] = {0};
-    int valread = read(sockCliente, buffer, BUFFERSIZE - 1);
-    if (valread <= 0) {
-        close(sockCliente);
-        activeClients--;
-        return;
+    IdTemporizador programar(std::chrono::milliseconds retraso, std::function<void()> accion) {
+        uint32_t i = nuevoNodo();
+        Nodo &n = nodos[i];
+        uint64_t delta = retraso.count() > 0 ? (uint64_t)retraso.count() : 1;
+        // El tick actual puede estar atrasado respecto del reloj si el reactor estuvo ocupado
+        n.vence = tickDe(Reloj::now()) + delta;
+        if (n.vence <= ahora) n.vence = ahora + 1;
+        n.accion = std::move(accion);
+        insertar(i);
+        activos++;
+        return (uint64_t(i) << 32) | n.generacion;
     }
-    buffer[valread] = '\0';
-    std::string nombre(buffer);
-    while (!nombre.empty() && (nombre.back() == '\n' || nombre.back() == '\r')) nombre.pop_back();
 
-    // Registrar cliente (en menu por defecto)
-    {
-        std::lock_guard<std::mutex> lock(clients_mutex);
-        ClientInfo ci;
-        ci.sock = sockCliente;
-        ci.name = nombre;
-        ci.id = clientId;
-        ci.inMenu = true;
-        clients.push_back(ci);
+    void cancelar(IdTemporizador id) {
+        uint32_t i = uint32_t(id >> 32);
+        if (id == 0 || i >= nodos.size()) return;
+        Nodo &n = nodos[i];
+        if (n.generacion != uint32_t(id) || n.nivel < 0) return; // ya venció o fue cancelado
+        desenlazar(i);
+        liberarNodo(i);
+        activos--;
     }
 
-    // Enviar bienvenida local y notificar a la sala
-    std::string bienvenida = "Bienvenido " + nombre + "\n";
-    send(sockCliente, bienvenida.c_str(), bienvenida.size(), 0);
-    broadcastMessage("Usuario " + nombre + " se ha conectado\n", sockCliente);
-    // Enviar menú inicial al cliente
-    sendMenuToClient(sockCliente);
+    // Milisegundos hasta el próximo vencimiento (-1 si no hay temporizadores)
+    int msHastaProximo() const {
+        if (activos == 0) return -1;
+        uint64_t ahoraReal = tickDe(Reloj::now());
+        if (ahoraReal > ahora) return 0;
+        uint64_t mejor = UINT64_MAX;
+        for (int nivel = 0; nivel < kNiveles; ++nivel) {
+            if (cuentaNivel[nivel] == 0) continue;
+            int bits = kBits * nivel;
+            uint64_t base = ahora >> bits;
+            for (uint64_t k = 1; k <= kRanuras; ++k) {
+                if (ranuras[nivel][(base + k) & kMascara] == kNulo) continue;
+                // En el nivel 0 es el vencimiento exacto; arriba, el momento de la cascada
+                uint64_t tick = (base + k) << bits;
+                mejor = std::min(mejor, tick - ahora);
+                break;
+            }
+        }
+        if (mejor == UINT64_MAX) return 0;
+        return (int)std::min<uint64_t>(mejor, INT32_MAX);
+    }
 
-    // Bucle principal: recibir mensajes del cliente
-    while (true) {
-        char buf[BUFFERSIZE] = {0};
-        int n = read(sockCliente, buf, BUFFERSIZE - 1);
-        if (n <= 0) break;
-        buf[n] = '\0';
-        std::string msg(buf);
-        // Trim leading/trailing whitespace
-        msg = trim(msg);
-
-        if (msg.empty()) continue;
-
-        // Comandos que inician juegos
-        if (msg == "/juego_trivia") {
-            if (!triviaActive.load()) {
-                // marcar a todos como en juego y lanzar trivia
-                setAllClientsMenuState(false);
-                std::thread t(triviaThread);
-                t.detach();
-            } else {
-                send(sockCliente, "Ya hay una trivia en curso\n", 22, 0);
+    // Ejecuta todo lo vencido hasta el instante actual
+    void avanzar() {
+        uint64_t objetivo = tickDe(Reloj::now());
+        while (ahora < objetivo) {
+            if (activos == 0) {
+                ahora = objetivo;
+                break;
             }
-            continue;
+            if (cuentaNivel[0] == 0) {
+                // Nada en el nivel 0: saltar hasta el tick previo al próximo límite de cascada
+                uint64_t limite = ahora | kMascara;
+                if (limite >= objetivo) {
+                    ahora = objetivo;
+                    break;
+                }
+                ahora = limite;
+            }
+            ahora++;
+            if ((ahora & kMascara) == 0) cascada(1);
+            ejecutarRanura(ranuras[0][ahora & kMascara]);
         }
+    }
 
-        if (msg == "/piedra_papel_tijera") {
-            setClientMenuState(clientId, false); // Mark as out of menu to process game input
-            
-            std::string prompt = "Elige modo: 1) vs Maquina 2) vs Jugador\n";
-            send(sockCliente, prompt.c_str(), prompt.size(), 0);
+    size_t pendientes() const { return activos; }
 
-            char choiceBuf[BUFFERSIZE] = {0};
-            int cn = read(sockCliente, choiceBuf, BUFFERSIZE - 1);
+private:
+    static constexpr int kNiveles = 4;
+    static constexpr int kBits = 8;
+    static constexpr uint64_t kRanuras = 1u << kBits;
+    static constexpr uint64_t kMascara = kRanuras - 1;
+    static constexpr uint32_t kNulo = UINT32_MAX;
 
-            if (cn > 0) {
-                choiceBuf[cn] = '\0';
-                std::string choice = trim(std::string(choiceBuf));
+    struct Nodo {
+        uint64_t vence = 0;          // tick absoluto
+        std::function<void()> accion;
+        uint32_t anterior = kNulo, siguiente = kNulo;
+        uint32_t generacion = 1;
+        int nivel = -1, ranura = 0;  // nivel -1: libre
+    };
 
-                if (choice == "1") {
-                    playRPSvsMachine(sockCliente, nombre);
-                } else if (choice == "2") {
-                    playRPSvsPlayer(sockCliente, nombre, clientId);
-                } else {
-                    send(sockCliente, "Opción inválida. Volviendo al menú.\n", 38, 0);
-                    setClientMenuState(clientId, true); // Restore menu state
-                    sendMenuToClient(sockCliente);
-                }
-            } else {
-                // Error or disconnect, restore menu state and the loop will exit
-                setClientMenuState(clientId, true);
-            }
-            continue; // After handling game logic, continue to the next loop iteration
-        }
-
-        // Si hay una pregunta activa para la trivia, chequear respuestas
-        if (triviaActive.load() && questionActive.load()) {
-            std::string lower = trim(msg);
-                    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-                    std::lock_guard<std::mutex> lock(trivia_mutex);
-                    if (questionActive.load() && !answered.load() && lower == currentAnswer) {
-                        // Otorgar punto y registrar al respondedor
-                        triviaScores[clientId]++;
-                        answered = true;
-                        triviaLastResponder = clientId;
-                    }
-            // Si la trivia está activa, también no hacemos broadcast normal
-            continue;
-        }
+    Reloj::time_point origen;
+    uint64_t ahora = 0;              // último tick procesado
+    std::vector<Nodo> nodos;
+    std::vector<uint32_t> libres;
+    uint32_t ranuras[kNiveles][kRanuras];
+    size_t cuentaNivel[kNiveles] = {0, 0, 0, 0};
+    size_t activos = 0;
 
-        // Comando para desconectarse
-        if (msg == "BYE") {
-            std::string despedida = "Adios " + nombre + "\n";
-            send(sockCliente, despedida.c_str(), despedida.size(), 0);
-            break;
-        }
+    uint64_t tickDe(Reloj::time_point t) const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(t - origen).count();
+    }
 
-        // Si el cliente está en el menu principal, permitimos chat directo solo si hay 2 usuarios.
-        bool isInMenu = false;
-        {
-            std::lock_guard<std::mutex> lock(clients_mutex);
-            for (auto &c : clients) if (c.id == clientId) { isInMenu = c.inMenu; break; }
-        }
-        if (isInMenu) {
-            std::lock_guard<std::mutex> lock(clients_mutex);
-            if (clients.size() == 2) {
-                // Enviar solo al otro usuario
-                for (auto &c : clients) {
-                    if (c.id != clientId) {
-                        std::string privado = nombre + " (privado): " + msg + "\n";
-                        send(c.sock, privado.c_str(), privado.size(), 0);
-                        break;
-                    }
-                }
-            } else {
-                std::string info = "En el menu principal. Comandos disponibles:\n";
-                info += "/juego_trivia\n";
-                info += "/piedra_papel_tijera\n";
-                info += "Escribe comando para jugar.\n";
-                send(sockCliente, info.c_str(), info.size(), 0);
-            }
-            continue;
+    uint32_t nuevoNodo() {
+        if (!libres.empty()) {
+            uint32_t i = libres.back();
+            libres.pop_back();
+            return i;
         }
+        nodos.emplace_back();
+        return uint32_t(nodos.size() - 1);
+    }
 
-        // Mensaje normal: reenviar a todos
-        std::string paraSala = nombre + ": " + msg + "\n";
-        broadcastMessage(paraSala, sockCliente);
+    void liberarNodo(uint32_t i) {
+        Nodo &n = nodos[i];
+        n.accion = nullptr;
+        n.nivel = -1;
+        if (++n.generacion == 0) n.generacion = 1; // 0 queda reservado para "ninguno"
+        libres.push_back(i);
     }
 
-    // Limpieza al desconectar
-    close(sockCliente);
-    {
-        std::lock_guard<std::mutex> lock(clients_mutex);
-        clients.erase(std::remove_if(clients.begin(), clients.end(), [clientId](const ClientInfo &c){ return c.id == clientId; }), clients.end());
+    void insertar(uint32_t i) {
+        Nodo &n = nodos[i];
+        uint64_t delta = n.vence - ahora;
+        int nivel = 0;
+        while (nivel < kNiveles - 1 && delta >= (uint64_t(1) << (kBits * (nivel + 1)))) nivel++;
+        uint64_t vence = n.vence;
+        // Más allá del último nivel (~49 días) se acota al horizonte de la rueda
+        if (nivel == kNiveles - 1 && delta >= (uint64_t(1) << (kBits * kNiveles)))
+            vence = ahora + (uint64_t(1) << (kBits * kNiveles)) - 1;
+        n.nivel = nivel;
+        n.ranura = int((vence >> (kBits * nivel)) & kMascara);
+        uint32_t &cabeza = ranuras[nivel][n.ranura];
+        n.anterior = kNulo;
+        n.siguiente = cabeza;
+        if (cabeza != kNulo) nodos[cabeza].anterior = i;
+        cabeza = i;
+        cuentaNivel[nivel]++;
     }
-    
-    activeClients--;
-    std::cout << "Cliente " << clientId << " desconectado" << std::endl;
-} // <-- This closes manejarCliente
 
-int main(int argc, char *argv[]) {
-        if (argc < 2) {
-            std::cerr << "Uso: " << argv[0] << " <nClientes>  (ej: " << argv[0] << " 1)" << std::endl;
-            return 1;
-        }
+    void desenlazar(uint32_t i) {
+        Nodo &n = nodos[i];
+        if (n.anterior != kNulo) nodos[n.anterior].siguiente = n.siguiente;
+        else ranuras[n.nivel][n.ranura] = n.siguiente;
+        if (n.siguiente != kNulo) nodos[n.siguiente].anterior = n.anterior;
+        cuentaNivel[n.nivel]--;
+        n.anterior = n.siguiente = kNulo;
+    }
 
-        int nClientes = 0;
-        try {
-            nClientes = std::stoi(argv[1]);
-        } catch (const std::invalid_argument &e) {
-            std::cerr << "Argumento inválido para nClientes: debe ser un número entero positivo.\n";
-            std::cerr << "Uso: " << argv[0] << " <nClientes>  (ej: " << argv[0] << " 1)" << std::endl;
-            return 1;
-        } catch (const std::out_of_range &e) {
-            std::cerr << "Argumento fuera de rango para nClientes." << std::endl;
-            return 1;
+    // Redistribuye la ranura actual del nivel dado en los niveles inferiores
+    void cascada(int nivel) {
+        if (nivel >= kNiveles) return;
+        uint64_t indice = (ahora >> (kBits * nivel)) & kMascara;
+        if (indice == 0) cascada(nivel + 1);
+        uint32_t i = ranuras[nivel][indice];
+        while (i != kNulo) {
+            uint32_t sig = nodos[i].siguiente;
+            desenlazar(i);
+            insertar(i);
+            i = sig;
         }
+    }
 
-        if (nClientes < 1) {
-            std::cerr << "nClientes debe ser >= 1" << std::endl;
-            return 1;
+    void ejecutarRanura(uint32_t &cabeza) {
+        // Las acciones pueden programar o cancelar otros temporizadores
+        while (cabeza != kNulo) {
+            uint32_t i = cabeza;
+            desenlazar(i);
+            std::function<void()> accion = std::move(nodos[i].accion);
+            liberarNodo(i);
+            activos--;
+            accion();
         }
+    }
+};
 
-        // 1. Configuración del Socket
-        int sockServidor;
-        crearSocket(sockServidor);
+// Backend io_uring (--io=uring) con llamadas al sistema directas, sin
+// liburing. Las recepciones son multishot y toman sus buffers de un anillo de
+// buffers provistos; accept también es multishot; los envíos de toda la
+// iteración salen en el mismo io_uring_enter con el que el reactor espera.
+// Un anillo por reactor, creado y usado solo por su hilo.
+struct OperacionIO {
+    enum Tipo { Aceptar, Recibir, Enviar, Despertar, Admin };
 
-        // 2. Vinculación
-        struct sockaddr_in confServidor;
-        configurarServidor(sockServidor, confServidor);
+    explicit OperacionIO(Tipo tipo) : tipo(tipo) {}
 
-        // 3. Escuchando conexiones entrantes
-        escucharClientes(sockServidor, nClientes);
+    Tipo tipo;
+    std::shared_ptr<Conexion> conn;       // la conexión sigue viva hasta el último completado
+    std::vector<Mensaje> mensajes;        // lo que está enviando (Enviar)
+    std::vector<struct iovec> iov;
+    struct msghdr mh {};
+};
 
-        std::cout << "Servidor escuchando en puerto " << PORT << std::endl;
-        std::cout << "Máximo de clientes simultáneos: " << nClientes << std::endl;
+class AnilloIO {
+public:
+    static constexpr uint16_t kGrupoBuffers = 0;
 
-        // 4. Aceptar conexiones (cada conexión en su propio hilo)
-        std::cout << "Esperando conexiones..." << std::endl;
-        int clienteIdCounter = 0;
+    AnilloIO() = default;
+    AnilloIO(const AnilloIO &) = delete;
+    AnilloIO &operator=(const AnilloIO &) = delete;
+
+    ~AnilloIO() {
+        if (memoriaBuffers) munmap(memoriaBuffers, size_t(numBuffers) * tamBuffer);
+        if (buffers) munmap(buffers, tamAnilloBuffers);
+        if (sqes) munmap(sqes, sqEntradas * sizeof(struct io_uring_sqe));
+        if (anillos) munmap(anillos, tamAnillos);
+        if (fd >= 0) close(fd);
+    }
+
+    bool iniciar(unsigned entradas, std::string &error) {
+        struct io_uring_params p;
+        // Un solo hilo envía y espera: el kernel puede diferir el trabajo
+        // de los completados hasta io_uring_enter. Kernels viejos no lo aceptan.
+        const unsigned opciones[] = {IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+                                     IORING_SETUP_COOP_TASKRUN, 0};
+        for (unsigned o : opciones) {
+            std::memset(&p, 0, sizeof(p));
+            p.flags = o | IORING_SETUP_CQSIZE;
+            p.cq_entries = entradas * 8;   // holgura para las recepciones multishot
+            fd = (int)syscall(__NR_io_uring_setup, entradas, &p);
+            if (fd >= 0 || errno != EINVAL) break;
+        }
+        if (fd < 0) {
+            error = std::string("io_uring_setup: ") + std::strerror(errno);
+            return false;
+        }
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+            error = "el kernel no soporta IORING_FEAT_SINGLE_MMAP/EXT_ARG";
+            return false;
+        }
+        tamAnillos = std::max<size_t>(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                                      p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe));
+        anillos = mmap(nullptr, tamAnillos, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (anillos == MAP_FAILED) {
+            anillos = nullptr;
+            error = std::string("mmap del anillo: ") + std::strerror(errno);
+            return false;
+        }
+        sqEntradas = p.sq_entries;
+        void *m = mmap(nullptr, sqEntradas * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (m == MAP_FAILED) {
+            error = std::string("mmap de las SQE: ") + std::strerror(errno);
+            return false;
+        }
+        sqes = static_cast<struct io_uring_sqe *>(m);
+
+        char *base = static_cast<char *>(anillos);
+        sqCabeza = reinterpret_cast<unsigned *>(base + p.sq_off.head);
+        sqCola = reinterpret_cast<unsigned *>(base + p.sq_off.tail);
+        sqMascara = *reinterpret_cast<unsigned *>(base + p.sq_off.ring_mask);
+        unsigned *indices = reinterpret_cast<unsigned *>(base + p.sq_off.array);
+        for (unsigned i = 0; i < sqEntradas; ++i) indices[i] = i; // la SQE i va en la ranura i
+        cqCabeza = reinterpret_cast<unsigned *>(base + p.cq_off.head);
+        cqCola = reinterpret_cast<unsigned *>(base + p.cq_off.tail);
+        cqMascara = *reinterpret_cast<unsigned *>(base + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe *>(base + p.cq_off.cqes);
+        colaLocal = *sqCola;
+        return true;
+    }
+
+    // Registra el anillo de buffers provistos (cantidad potencia de dos)
+    bool registrarBuffers(unsigned cantidad, unsigned tam, std::string &error) {
+        numBuffers = cantidad;
+        tamBuffer = tam;
+        tamAnilloBuffers = cantidad * sizeof(struct io_uring_buf);
+        void *m = mmap(nullptr, tamAnilloBuffers, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        void *datos = mmap(nullptr, size_t(cantidad) * tam, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED || datos == MAP_FAILED) {
+            if (m != MAP_FAILED) munmap(m, tamAnilloBuffers);
+            if (datos != MAP_FAILED) munmap(datos, size_t(cantidad) * tam);
+            error = std::string("mmap de los buffers: ") + std::strerror(errno);
+            return false;
+        }
+        // Se indexa como arreglo de io_uring_buf: en C++ el arreglo flexible de
+        // io_uring_buf_ring queda desplazado. La cola va en el resv del primero.
+        buffers = static_cast<struct io_uring_buf *>(m);
+        memoriaBuffers = static_cast<char *>(datos);
+        struct io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(buffers);
+        reg.ring_entries = cantidad;
+        reg.bgid = kGrupoBuffers;
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            error = std::string("IORING_REGISTER_PBUF_RING: ") + std::strerror(errno);
+            return false;
+        }
+        for (unsigned i = 0; i < cantidad; ++i) devolverBuffer(i);
+        return true;
+    }
+
+    const char *buffer(uint16_t id) const { return memoriaBuffers + size_t(id) * tamBuffer; }
+
+    void devolverBuffer(uint16_t id) {
+        struct io_uring_buf &b = buffers[colaBuffers & (numBuffers - 1)];
+        b.addr = reinterpret_cast<uint64_t>(buffer(id));
+        b.len = tamBuffer;
+        b.bid = id;
+        colaBuffers++;
+        __atomic_store_n(&buffers[0].resv, colaBuffers, __ATOMIC_RELEASE);
+    }
+
+    void aceptarMultishot(int sock, OperacionIO *op) {
+        struct io_uring_sqe *e = sqe(IORING_OP_ACCEPT, sock, op);
+        e->ioprio = IORING_ACCEPT_MULTISHOT;
+        e->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    }
+
+    void recibirMultishot(int sock, OperacionIO *op) {
+        struct io_uring_sqe *e = sqe(IORING_OP_RECV, sock, op);
+        e->ioprio = IORING_RECV_MULTISHOT;
+        e->flags = IOSQE_BUFFER_SELECT;
+        e->buf_group = kGrupoBuffers;
+    }
+
+    void enviar(int sock, OperacionIO *op) {
+        struct io_uring_sqe *e = sqe(IORING_OP_SENDMSG, sock, op);
+        e->addr = reinterpret_cast<uint64_t>(&op->mh);
+        e->len = 1;
+        e->msg_flags = MSG_NOSIGNAL;
+    }
+
+    void sondearMultishot(int fd, OperacionIO *op) {
+        struct io_uring_sqe *e = sqe(IORING_OP_POLL_ADD, fd, op);
+        e->len = IORING_POLL_ADD_MULTI;
+        e->poll32_events = POLLIN;
+    }
+
+    // El completado de la cancelación lleva user_data 0 y se ignora
+    void cancelar(OperacionIO *op) {
+        struct io_uring_sqe *e = sqe(IORING_OP_ASYNC_CANCEL, -1, nullptr);
+        e->addr = reinterpret_cast<uint64_t>(op);
+    }
+
+    // Entrega al kernel las SQE preparadas, sin esperar
+    void enviarPendientes() {
+        if (colaLocal != __atomic_load_n(sqCabeza, __ATOMIC_ACQUIRE)) entrar(0, 0, nullptr);
+    }
+
+    // Entrega lo preparado y espera al menos un completado o hasta ms
+    // milisegundos (-1 = sin plazo): una sola llamada al sistema por iteración.
+    void esperar(int ms) {
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        std::memset(&arg, 0, sizeof(arg));
+        if (ms > 0) {
+            ts.tv_sec = ms / 1000;
+            ts.tv_nsec = (ms % 1000) * 1000000LL;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+        entrar(ms == 0 ? 0 : 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg);
+    }
+
+    // Recorre los completados disponibles
+    template <class F>
+    void completados(F &&f) {
+        unsigned cabeza = *cqCabeza;
+        unsigned cola = __atomic_load_n(cqCola, __ATOMIC_ACQUIRE);
+        for (; cabeza != cola; ++cabeza) {
+            f(cqes[cabeza & cqMascara]);
+            __atomic_store_n(cqCabeza, cabeza + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+private:
+    int fd = -1;
+    void *anillos = nullptr;
+    size_t tamAnillos = 0;
+    struct io_uring_sqe *sqes = nullptr;
+    unsigned sqEntradas = 0, sqMascara = 0, colaLocal = 0;
+    unsigned *sqCabeza = nullptr, *sqCola = nullptr;
+    unsigned *cqCabeza = nullptr, *cqCola = nullptr, cqMascara = 0;
+    struct io_uring_cqe *cqes = nullptr;
+
+    struct io_uring_buf *buffers = nullptr;
+    size_t tamAnilloBuffers = 0;
+    char *memoriaBuffers = nullptr;
+    unsigned numBuffers = 0, tamBuffer = 0;
+    uint16_t colaBuffers = 0;
+
+    void entrar(unsigned minimo, unsigned flags, struct io_uring_getevents_arg *arg) {
+        __atomic_store_n(sqCola, colaLocal, __ATOMIC_RELEASE);
+        unsigned pendientes = colaLocal - __atomic_load_n(sqCabeza, __ATOMIC_ACQUIRE);
+        metricas().llamadasES.sumar();
+        if (syscall(__NR_io_uring_enter, fd, pendientes, minimo, flags, arg, arg ? sizeof(*arg) : 0) < 0
+            && errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            std::cerr << "Error io_uring_enter: " << std::strerror(errno) << std::endl;
+    }
+
+    // Siguiente SQE libre; si el anillo está lleno se entrega lo preparado
+    struct io_uring_sqe *sqe(uint8_t opcode, int fd, OperacionIO *op) {
+        while (colaLocal - __atomic_load_n(sqCabeza, __ATOMIC_ACQUIRE) >= sqEntradas) entrar(0, 0, nullptr);
+        struct io_uring_sqe *e = &sqes[colaLocal & sqMascara];
+        std::memset(e, 0, sizeof(*e));
+        e->opcode = opcode;
+        e->fd = fd;
+        e->user_data = reinterpret_cast<uint64_t>(op);
+        colaLocal++;
+        return e;
+    }
+};
+
+// Un reactor: un hilo con su propio epoll (o anillo io_uring), socket de
+// escucha (SO_REUSEPORT), tabla de conexiones y temporizadores. Cada conexión
+// pertenece a un solo reactor y solo ese hilo toca su estado; los demás le
+// dejan trabajo en su buzón y lo despiertan con su eventfd.
+struct Reactor {
+    int indice = 0;
+    int epfd = -1;
+    int sockServidor = -1;
+    int eventfd = -1;
+
+    // Tabla de conexiones (solo se toca desde el hilo del reactor)
+    std::unordered_map<int, std::shared_ptr<Conexion>> conexiones;
+    std::atomic<size_t> numConexiones{0}; // para el reporte desde otros hilos
+    RuedaTemporizadores rueda;
+    uint64_t iteracion = 0;               // vueltas del bucle de eventos
+
+    // Conexiones a liberar al terminar la iteración actual. Diferir el cierre evita
+    // punteros colgantes en el lote de eventos que se está procesando.
+    std::vector<int> porCerrar;
+
+    // Conexiones a las que el propio reactor encoló salida en esta iteración.
+    // Se vacían todas juntas al final: lo encolado en un mismo ciclo (pregunta +
+    // aviso, resultados + fin + menú) sale en un solo writev.
+    std::vector<std::shared_ptr<Conexion>> vaciarEnTick;
+
+    // Lo mismo para conexiones de otros reactores, por destino: se entregan al
+    // final de la iteración con un solo lock y un solo aviso por reactor.
+    std::vector<std::vector<std::shared_ptr<Conexion>>> salientes;
+
+    // Buzón: conexiones con salida pendiente y tareas que dejan otros hilos
+    std::mutex buzon_mutex;
+    std::vector<std::shared_ptr<Conexion>> porVaciar;
+    std::vector<std::function<void()>> tareas;
+    std::atomic<bool> avisado{false};     // ya hay un aviso sin leer en el eventfd
+
+    // Backend io_uring: nullptr con epoll
+    std::unique_ptr<AnilloIO> anillo;
+    OperacionIO opAceptar{OperacionIO::Aceptar};
+    OperacionIO opDespertar{OperacionIO::Despertar};
+    OperacionIO opAdmin{OperacionIO::Admin};
+
+    void despertar() {
+        if (avisado.exchange(true)) return;
+        uint64_t uno = 1;
+        if (write(eventfd, &uno, sizeof(uno)) < 0 && errno != EAGAIN)
+            std::cerr << "Error despertando al reactor: " << std::strerror(errno) << std::endl;
+    }
+
+    // Deja una tarea para que este reactor la ejecute al final de su iteración
+    void publicar(std::function<void()> tarea) {
+        {
+            auto lock = bloquear(buzon_mutex, LockMedido::Vaciado);
+            tareas.push_back(std::move(tarea));
+        }
+        despertar();
+    }
+};
+
+static std::vector<std::unique_ptr<Reactor>> reactores;
+static std::atomic<bool> deteniendo{false}; // cada reactor sale de su bucle al despertar
+static thread_local Reactor *reactorActual = nullptr; // nullptr fuera de los reactores
+
+static Conexion *buscarConexion(int sock) {
+    auto &conexiones = reactorActual->conexiones;
+    auto it = conexiones.find(sock);
+    return it == conexiones.end() ? nullptr : it->second.get();
+}
+
+void marcarCierre(Conexion &c);
+
+// ---------------------------------------------------------------------------
+// Ejecutor de trabajo diferido: lo que no tiene por qué frenar a un reactor
+// (armar y enviar los reportes de /stats y del puerto de administración)
+// corre en un número fijo de hilos creados al arrancar. Cada trabajador tiene su cola: saca por el final lo
+// último que encoló él mismo y, si se queda sin trabajo, roba por el frente
+// de las colas de los demás. Quien encola desde fuera reparte en ronda.
+// Las colas están acotadas en conjunto: sin lugar, enviar() devuelve false y
+// el trabajo se hace en el llamador, así que una ráfaga frena a quien la
+// produce en vez de acumular memoria.
+class Ejecutor {
+public:
+    using Tarea = std::function<void()>;
+
+    ~Ejecutor() { detener(); }
+
+    void iniciar(int hilos, size_t maxEnCola) {
+        capacidad = maxEnCola;
+        for (int i = 0; i < hilos; ++i) colas.push_back(std::make_unique<Cola>());
+        for (int i = 0; i < hilos; ++i) trabajadores.emplace_back([this, i]{ trabajar(i); });
+    }
+
+    // Toma la tarea solo si la encola (si devuelve false sigue siendo del llamador)
+    bool enviar(Tarea &tarea) {
+        if (colas.empty()) return false;
+        if (pendientes.fetch_add(1) >= capacidad) {
+            pendientes--;
+            return false;
+        }
+        size_t i = (propio >= 0 ? propio : siguiente.fetch_add(1, std::memory_order_relaxed) % colas.size());
+        {
+            std::lock_guard<std::mutex> lock(colas[i]->mutex);
+            colas[i]->tareas.push_back(std::move(tarea));
+        }
+        if (durmiendo.load() > 0) {
+            std::lock_guard<std::mutex> lock(dormir_mutex);
+            hayTrabajo.notify_one();
+        }
+        return true;
+    }
+
+    // Termina lo que ya está encolado y espera a los trabajadores
+    void detener() {
+        {
+            std::lock_guard<std::mutex> lock(dormir_mutex);
+            detenido = true;
+        }
+        hayTrabajo.notify_all();
+        for (auto &t : trabajadores) t.join();
+        trabajadores.clear();
+    }
+
+    size_t hilos() const { return colas.size(); }
+    size_t enCola() const { return pendientes.load(); }
 
+private:
+    struct Cola {
+        std::mutex mutex;
+        std::deque<Tarea> tareas;
+    };
+
+    void trabajar(int yo) {
+        propio = yo;
+        Tarea tarea;
         while (true) {
-            int sockCliente;
-            struct sockaddr_in confCliente;
+            if (tomar(yo, tarea)) {
+                tarea();
+                tarea = nullptr;
+                metricas().tareas.sumar();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(dormir_mutex);
+            durmiendo++;
+            hayTrabajo.wait(lock, [this]{ return pendientes.load() > 0 || detenido; });
+            durmiendo--;
+            if (detenido && pendientes.load() == 0) return;
+        }
+    }
+
+    bool tomar(int yo, Tarea &tarea) {
+        for (size_t k = 0; k < colas.size(); ++k) {
+            Cola &cola = *colas[(yo + k) % colas.size()];
+            std::lock_guard<std::mutex> lock(cola.mutex);
+            if (cola.tareas.empty()) continue;
+            if (k == 0) {
+                tarea = std::move(cola.tareas.back());
+                cola.tareas.pop_back();
+            } else {
+                tarea = std::move(cola.tareas.front());
+                cola.tareas.pop_front();
+                metricas().tareasRobadas.sumar();
+            }
+            pendientes--;
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<std::unique_ptr<Cola>> colas;
+    std::vector<std::thread> trabajadores;
+    size_t capacidad = 0;
+    std::atomic<size_t> pendientes{0};   // encoladas y aún no tomadas
+    std::atomic<size_t> siguiente{0};    // ronda para quien encola desde fuera
+    std::atomic<int> durmiendo{0};
+    std::mutex dormir_mutex;
+    std::condition_variable hayTrabajo;
+    bool detenido = false;
+    inline static thread_local int propio = -1; // índice del trabajador actual
+};
+
+static constexpr size_t kMaxTareasDiferidas = 1024;
+static Ejecutor ejecutor;
+
+// Corre la tarea en el ejecutor; sin trabajadores o con la cola llena, en el acto
+static void diferir(std::function<void()> tarea) {
+    if (ejecutor.enviar(tarea)) return;
+    if (ejecutor.hilos()) metricas().tareasEnLlamador.sumar();
+    tarea();
+}
+
+// Agrega la conexión a la lista que su reactor revisa al final de cada iteración
+static void programarVaciado(std::shared_ptr<Conexion> c) {
+    Reactor *dueno = c->dueno.load(std::memory_order_acquire);
+    if (dueno == reactorActual) {
+        reactorActual->vaciarEnTick.push_back(std::move(c));
+        return;
+    }
+    if (reactorActual) {
+        reactorActual->salientes[dueno->indice].push_back(std::move(c));
+        return;
+    }
+    {
+        auto lock = bloquear(dueno->buzon_mutex, LockMedido::Vaciado);
+        dueno->porVaciar.push_back(std::move(c));
+    }
+    dueno->despertar();
+}
+
+// Entrega a cada reactor las conexiones suyas a las que este encoló salida
+static void entregarSalientes() {
+    Reactor &r = *reactorActual;
+    for (size_t i = 0; i < r.salientes.size(); ++i) {
+        auto &lista = r.salientes[i];
+        if (lista.empty()) continue;
+        Reactor &destino = *reactores[i];
+        {
+            auto lock = bloquear(destino.buzon_mutex, LockMedido::Vaciado);
+            destino.porVaciar.insert(destino.porVaciar.end(), std::make_move_iterator(lista.begin()),
+                                     std::make_move_iterator(lista.end()));
+        }
+        lista.clear();
+        destino.despertar();
+    }
+}
+
+// Ejecuta las tareas que otros hilos dejaron en el buzón
+static void procesarBuzon() {
+    Reactor &r = *reactorActual;
+    std::vector<std::function<void()>> tareas;
+    {
+        auto lock = bloquear(r.buzon_mutex, LockMedido::Vaciado);
+        tareas.swap(r.tareas);
+    }
+    for (auto &tarea : tareas) tarea();
+}
+
+// Ejecuta la tarea en el reactor dueño de la conexión. Si la conexión se
+// traspasa antes de que la tarea corra, la tarea la sigue al reactor nuevo.
+static void enDueno(const std::shared_ptr<Conexion> &c, std::function<void(Conexion &)> tarea) {
+    Reactor *dueno = c->dueno.load(std::memory_order_acquire);
+    if (dueno == reactorActual) {
+        tarea(*c);
+        return;
+    }
+    dueno->publicar([c, tarea = std::move(tarea)]() mutable { enDueno(c, std::move(tarea)); });
+}
+
+// Agrega a la cola sin más chequeos (con salida_mutex)
+static void encolarSalida(Conexion &c, const Mensaje &msg, TipoMensaje tipo) {
+    c.salida.push_back({msg, tipo});
+    c.bytesSalida += msg->size();
+    if (tipo == TipoMensaje::Chat) c.bytesChat += msg->size();
+    bytesEnColas += msg->size();
+}
+
+// Al bajar de la marca baja se reanuda el chat y se avisa cuántos mensajes
+// no le llegaron (con salida_mutex)
+static void reanudarChat(Conexion &c) {
+    if (c.bytesSalida > config.salidaBaja || (!c.chatPausado && !c.chatOmitido)) return;
+    c.chatPausado = false;
+    if (!c.chatOmitido) return;
+    encolarSalida(c, hacerMensaje("[servidor] conexión lenta: se omitieron " + std::to_string(c.chatOmitido) +
+                                  " mensajes de chat\n"), TipoMensaje::Control);
+    metricas().mensajesSalida.sumar();
+    c.chatOmitido = 0;
+}
+
+// Descarta de la cola de salida los bytes ya escritos (con salida_mutex)
+static void consumirSalida(Conexion &c, size_t escritos) {
+    c.bytesSalida -= escritos;
+    c.bytesRechazados -= std::min(c.bytesRechazados, escritos);
+    while (escritos > 0) {
+        size_t disponible = c.salida.front().msg->size() - c.offsetSalida;
+        if (escritos < disponible) {
+            c.offsetSalida += escritos;
+            break;
+        }
+        escritos -= disponible;
+        if (c.salida.front().tipo == TipoMensaje::Chat) c.bytesChat -= c.salida.front().msg->size();
+        c.salida.pop_front();
+        c.offsetSalida = 0;
+    }
+    reanudarChat(c);
+}
+
+// DescartarChat: quita los mensajes de chat más viejos hasta que 'entrante'
+// quepa bajo la marca baja. No toca el mensaje a medio escribir ni los que
+// están en un envío de io_uring. Una pasada que compacta la cola.
+static void descartarChat(Conexion &c, size_t entrante) {
+    size_t fijos = std::max<size_t>(c.enVuelo, c.offsetSalida ? 1 : 0);
+    size_t destino = fijos, descartados = 0;
+    for (size_t i = fijos; i < c.salida.size(); ++i) {
+        Saliente &s = c.salida[i];
+        if (s.tipo == TipoMensaje::Chat && c.bytesChat && c.bytesSalida + entrante > config.salidaBaja) {
+            size_t n = s.msg->size();
+            c.bytesSalida -= n;
+            c.bytesChat -= n;
+            bytesEnColas -= n;
+            descartados++;
+            continue;
+        }
+        if (destino != i) c.salida[destino] = std::move(s);
+        destino++;
+    }
+    c.salida.resize(destino);
+    c.bytesRechazados = std::min(c.bytesRechazados, c.bytesSalida);
+    c.chatOmitido += descartados;
+    metricas().chatOmitido.sumar(descartados);
+}
+
+// Decide si 'bytes' más caben en la cola (con salida_mutex). Las marcas se
+// comparan con lo que el socket ya rechazó, no con lo que solo espera el
+// vaciado de fin de iteración: una ráfaga hacia un lector sano no lo vuelve
+// lento. Bajo la marca alta se encola todo; por encima se aplica la política
+// de clientes lentos. El tráfico de control nunca se descarta, pero tampoco
+// crece sin límite: pasado el doble de la marca alta la conexión se cierra.
+static bool admitirSalida(Conexion &c, size_t bytes, size_t mensajes, TipoMensaje tipo) {
+    bool chat = (tipo == TipoMensaje::Chat);
+    auto omitir = [&]{
+        c.chatOmitido += mensajes;
+        metricas().chatOmitido.sumar(mensajes);
+        return false;
+    };
+    auto desconectar = [&]{
+        c.fallida = true;
+        metricas().lentosDesconectados.sumar();
+        return false;
+    };
+    if (chat && c.chatPausado) return omitir();
+    if (c.bytesRechazados + bytes <= config.salidaAlta) return true;
+    switch (config.lentos) {
+    case PoliticaLentos::Desconectar:
+        return desconectar();
+    case PoliticaLentos::DescartarChat:
+        if (c.bytesChat) descartarChat(c, bytes);
+        if (c.bytesRechazados + bytes <= config.salidaAlta) return true;
+        break;
+    case PoliticaLentos::PausarChat:
+        if (!c.chatPausado) metricas().pausasChat.sumar();
+        c.chatPausado = true;
+        break;
+    }
+    if (chat) return omitir();
+    if (c.bytesRechazados + bytes > 2 * config.salidaAlta) return desconectar();
+    return true;
+}
+
+// io_uring: prepara un envío con lo que quepa en un sendmsg. Los mensajes
+// siguen en la cola hasta el completado; la operación guarda su propia
+// referencia, así que el envío sobrevive al cierre de la conexión.
+static void vaciarSalidaAnillo(Conexion &c) {
+    auto lock = bloquear(c.salida_mutex, LockMedido::Salida);
+    // Un envío de una iteración anterior sin completar: el socket no acepta
+    if (c.enVuelo && c.iteracionEnvio != reactorActual->iteracion) c.bytesRechazados = c.bytesSalida;
+    if (c.cerrada || c.fallida || c.enVuelo || c.traspasoA || c.salida.empty()) return;
+    auto *op = new OperacionIO(OperacionIO::Enviar);
+    op->conn = c.shared_from_this();
+    size_t n = std::min<size_t>(c.salida.size(), MAX_IOV);
+    op->mensajes.reserve(n);
+    for (size_t i = 0; i < n; ++i) op->mensajes.push_back(c.salida[i].msg);
+    op->iov.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        size_t off = (i == 0 ? c.offsetSalida : 0);
+        op->iov[i].iov_base = const_cast<char *>(op->mensajes[i]->data()) + off;
+        op->iov[i].iov_len = op->mensajes[i]->size() - off;
+    }
+    op->mh.msg_iov = op->iov.data();
+    op->mh.msg_iovlen = n;
+    c.enVuelo = n;
+    c.iteracionEnvio = reactorActual->iteracion;
+    reactorActual->anillo->enviar(c.sock, op);
+}
+
+// Escribe con writev todo lo que el socket acepte. Solo desde el reactor.
+// Si queda algo pendiente, EPOLLOUT (edge-triggered) avisará cuando haya espacio.
+// Un error no cierra aquí: se programa para no reentrar en la lógica de juego.
+// Si la cola no cabe en un writev se tapona el socket (TCP_CORK) para que
+// las escrituras sucesivas no salgan como segmentos pequeños.
+static void vaciarSalida(Conexion &c) {
+    if (reactorActual->anillo) {
+        vaciarSalidaAnillo(c);
+        return;
+    }
+    bool programar = false;
+    size_t escritos = 0, llamadas = 0;
+    {
+        auto lock = bloquear(c.salida_mutex, LockMedido::Salida);
+        if (c.cerrada) return;
+        int taponado = (c.salida.size() > MAX_IOV ? 1 : 0);
+        if (taponado) setsockopt(c.sock, IPPROTO_TCP, TCP_CORK, &taponado, sizeof(taponado));
+        while (!c.fallida && !c.salida.empty()) {
+            struct iovec iov[MAX_IOV];
+            int n = 0;
+            for (auto it = c.salida.begin(); it != c.salida.end() && n < MAX_IOV; ++it, ++n) {
+                size_t off = (n == 0 ? c.offsetSalida : 0);
+                iov[n].iov_base = const_cast<char *>(it->msg->data()) + off;
+                iov[n].iov_len = it->msg->size() - off;
+            }
+            ssize_t w = writev(c.sock, iov, n);
+            llamadas++;
+            metricas().llamadasES.sumar();
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) c.fallida = true;
+                break;
+            }
+            consumirSalida(c, w);
+            escritos += w;
+        }
+        // Lo que quedó es lo que el socket rechazó
+        c.bytesRechazados = c.bytesSalida;
+        if (taponado) {
+            taponado = 0;
+            setsockopt(c.sock, IPPROTO_TCP, TCP_CORK, &taponado, sizeof(taponado));
+        }
+        if (c.fallida && !c.programada) {
+            c.programada = true;
+            programar = true;
+        }
+    }
+    if (llamadas) {
+        MetricasHilo &m = metricas();
+        m.escrituras.sumar(llamadas);
+        m.bytesSalida.sumar(escritos);
+        bytesEnColas -= escritos;
+    }
+    if (programar) programarVaciado(c.shared_from_this());
+}
+
+// Una ráfaga larga (p. ej. la de un cliente que manda cientos de KB de una
+// vez) no espera al final de la iteración: en el reactor dueño, cuando lo
+// pendiente de vaciar pasa la marca baja o lo que cabe en un writev, se
+// escribe en el acto, salvo que el socket ya esté rechazando (con salida_mutex).
+static bool hayQueVaciarYa(const Conexion &c) {
+    if (c.bytesRechazados || c.dueno.load(std::memory_order_relaxed) != reactorActual) return false;
+    return c.bytesSalida >= config.salidaBaja || c.salida.size() >= MAX_IOV;
+}
+
+// Encola un mensaje para el cliente. Normalmente no escribe: el reactor vacía
+// la cola al final de la iteración (desde otro hilo, además, se lo despierta).
+// La cola guarda una referencia al mensaje, no una copia. Un cliente lento no
+// bloquea a nadie: admitirSalida decide según la política configurada.
+void sendToClient(const std::shared_ptr<Conexion> &c, const Mensaje &msg,
+                  TipoMensaje tipo = TipoMensaje::Control) {
+    bool programar = false, vaciarYa = false;
+    {
+        auto lock = bloquear(c->salida_mutex, LockMedido::Salida);
+        if (c->cerrada || c->fallida) return;
+        if (!admitirSalida(*c, msg->size(), 1, tipo)) {
+            if (!c->fallida) return;
+        } else {
+            encolarSalida(*c, msg, tipo);
+            metricas().mensajesSalida.sumar();
+            vaciarYa = hayQueVaciarYa(*c);
+        }
+        if (!c->programada) {
+            c->programada = true;
+            programar = true;
+        }
+    }
+    if (vaciarYa) vaciarSalida(*c);
+    if (programar) programarVaciado(c);
+}
+
+// Encola un lote de mensajes con una sola toma del lock: salen juntos en el
+// mismo writev. El lote se admite o se rechaza entero, como un mensaje.
+void sendToClient(const std::shared_ptr<Conexion> &c, const std::vector<Mensaje> &lote,
+                  TipoMensaje tipo = TipoMensaje::Control) {
+    size_t bytes = 0;
+    for (auto &msg : lote) bytes += msg->size();
+    bool programar = false, vaciarYa = false;
+    {
+        auto lock = bloquear(c->salida_mutex, LockMedido::Salida);
+        if (c->cerrada || c->fallida) return;
+        if (!admitirSalida(*c, bytes, lote.size(), tipo)) {
+            if (!c->fallida) return;
+        } else {
+            for (auto &msg : lote) encolarSalida(*c, msg, tipo);
+            metricas().mensajesSalida.sumar(lote.size());
+            vaciarYa = hayQueVaciarYa(*c);
+        }
+        if (!c->programada) {
+            c->programada = true;
+            programar = true;
+        }
+    }
+    if (vaciarYa) vaciarSalida(*c);
+    if (programar) programarVaciado(c);
+}
 
-            aceptarConexion(sockCliente, sockServidor, confCliente);
+void sendToClient(const std::shared_ptr<Conexion> &c, const std::string &msg,
+                  TipoMensaje tipo = TipoMensaje::Control) {
+    sendToClient(c, hacerMensaje(msg), tipo);
+}
 
-            // Si ya alcanzamos el máximo de clientes concurrentes, rechazamos
-            if (activeClients.load() >= nClientes) {
-                std::string msg = "Servidor lleno, intente más tarde\n";
-                send(sockCliente, msg.c_str(), msg.size(), 0);
-                close(sockCliente);
-                std::cout << "Rechazada conexión: servidor lleno" << std::endl;
+// Vacía las conexiones programadas y desconecta las que fallaron (solo reactor).
+// Un cierre puede encolar avisos a otros clientes: se repite hasta agotar.
+static void procesarVaciados() {
+    Reactor &r = *reactorActual;
+    std::vector<std::shared_ptr<Conexion>> lista;
+    while (true) {
+        lista.swap(r.vaciarEnTick);
+        {
+            auto lock = bloquear(r.buzon_mutex, LockMedido::Vaciado);
+            lista.insert(lista.end(), std::make_move_iterator(r.porVaciar.begin()),
+                         std::make_move_iterator(r.porVaciar.end()));
+            r.porVaciar.clear();
+        }
+        if (lista.empty()) return;
+        for (auto &c : lista) {
+            // Traspasada a otro reactor: se le reenvía. En tránsito hacia este:
+            // se vacía al llegar.
+            if (c->dueno.load(std::memory_order_acquire) != &r) {
+                programarVaciado(c);
                 continue;
             }
+            if (buscarConexion(c->sock) != c.get()) continue;
+            bool fallida;
+            {
+                auto lock = bloquear(c->salida_mutex, LockMedido::Salida);
+                if (c->cerrada) continue;
+                c->programada = false;
+                fallida = c->fallida;
+            }
+            if (fallida) marcarCierre(*c);
+            else vaciarSalida(*c);
+        }
+        lista.clear();
+    }
+}
+
+// Variantes por socket para el código que corre en el reactor
+void sendToClient(int sock, const Mensaje &msg) {
+    auto &conexiones = reactorActual->conexiones;
+    auto it = conexiones.find(sock);
+    if (it != conexiones.end()) sendToClient(it->second, msg);
+}
+
+void sendToClient(int sock, const std::string &msg) {
+    auto &conexiones = reactorActual->conexiones;
+    auto it = conexiones.find(sock);
+    if (it != conexiones.end()) sendToClient(it->second, hacerMensaje(msg));
+}
+
+// Difusión a los miembros de una sala. El mensaje se comparte entre todos los
+// destinatarios: la memoria por difusión no crece con la cantidad de clientes.
+void broadcastMessage(const Sala &sala, const Mensaje &msg, int exceptSock = -1,
+                      TipoMensaje tipo = TipoMensaje::Control) {
+    auto inicio = Reloj::now();
+    auto miembros = sala.leerMiembros();
+    for (auto &c : *miembros) {
+        if (c->sock == exceptSock) continue;
+        sendToClient(c, msg, tipo);
+    }
+    MetricasHilo &m = metricas();
+    m.difusiones.sumar();
+    m.destinatarios.sumar(miembros->size());
+    m.difusion.registrar(inicio);
+}
+
+void broadcastMessage(const Sala &sala, const std::string &msg, int exceptSock = -1,
+                      TipoMensaje tipo = TipoMensaje::Control) {
+    broadcastMessage(sala, hacerMensaje(msg), exceptSock, tipo);
+}
+
+// Trim helper: remove leading and trailing whitespace (sin copiar)
+static std::string_view trim(std::string_view s) {
+    size_t start = 0;
+    while (start < s.size() && std::isspace((unsigned char)s[start])) start++;
+    size_t end = s.size();
+    while (end > start && std::isspace((unsigned char)s[end-1])) end--;
+    return s.substr(start, end - start);
+}
+
+// Comparación ASCII sin distinguir mayúsculas (sin copiar a minúsculas)
+static bool igualesSinMayusculas(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+    return true;
+}
+
+std::string getClientNameById(int id) {
+    auto reg = leerRegistro();
+    auto it = reg->porId.find(id);
+    return it != reg->porId.end() ? it->second->nombre : std::string("Desconocido");
+}
+
+int getClientIdBySock(int sock) {
+    auto reg = leerRegistro();
+    auto it = reg->porSock.find(sock);
+    return it != reg->porSock.end() ? it->second->id : -1;
+}
+
+void setClientMenuState(int clientId, bool state) {
+    auto reg = leerRegistro();
+    auto it = reg->porId.find(clientId);
+    if (it != reg->porId.end()) it->second->inMenu = state;
+}
+
+void setSalaMenuState(const Sala &sala, bool state) {
+    for (auto &c : *sala.leerMiembros()) c->inMenu = state;
+}
+
+// Textos fijos: se arman una vez al iniciar y se comparten en cada envío
+static const Mensaje kMenu = hacerMensaje(
+    "Menu principal - comandos disponibles:\n"
+    "/juego_trivia -> iniciar trivia (en tu sala)\n"
+    "/piedra_papel_tijera -> jugar RPS (vs maquina o vs jugador)\n"
+    "/unirse <sala>, /salir, /salas -> salas de chat\n"
+    "/msg <usuario> <texto> -> mensaje privado\n"
+    "/history [N] -> últimos mensajes de la sala\n");
+static const Mensaje kFinPartida = hacerMensaje("partida terminada, volviendo al menu principal\n");
+
+void sendMenuToClient(int sock) {
+    sendToClient(sock, kMenu);
+}
+
+void sendMenuToClient(const std::shared_ptr<Conexion> &c) {
+    sendToClient(c, kMenu);
+}
+
+
+IdTemporizador programarTemporizador(std::chrono::milliseconds retraso, std::function<void()> accion) {
+    return reactorActual->rueda.programar(retraso, std::move(accion));
+}
+
+void cancelarTemporizador(IdTemporizador id) {
+    reactorActual->rueda.cancelar(id);
+}
+
+static int msHastaProximoTemporizador() {
+    return reactorActual->rueda.msHastaProximo();
+}
+
+static void ejecutarTemporizadores() {
+    reactorActual->rueda.avanzar();
+}
+
+// ---------------------------------------------------------------------------
+// Banco de preguntas de trivia. Se compila desde un TSV a un archivo binario
+// (--compilar-banco) que el servidor mapea en memoria al iniciar (--banco):
+// no se copia nada al heap y el arranque no depende del tamaño del banco.
+//
+// Formato (enteros de 32 bits del host, todo alineado a 4 bytes):
+//   CabeceraBanco
+//   CategoriaBanco[numCategorias]
+//   CubetaBanco[numCategorias * kDificultades]
+//   uint32_t indice[numPreguntas]       ids agrupados por (categoría, dificultad)
+//   RegistroPregunta[numPreguntas]
+//   char textos[tamTextos]
+// Cada cubeta es un rango contiguo del índice. Las respuestas aceptadas (la
+// oficial y sus alias) vienen ya normalizadas y separadas por '\x1f'.
+// ---------------------------------------------------------------------------
+
+static constexpr char kMagiaBanco[8] = {'T', 'R', 'I', 'V', 'I', 'A', '0', '1'};
+static constexpr int kDificultades = 3;
+static const char *const nombresDificultad[kDificultades] = {"facil", "media", "dificil"};
+
+struct CabeceraBanco {
+    char magia[8];
+    uint32_t numPreguntas;
+    uint32_t numCategorias;
+    uint32_t tamTextos;
+    uint32_t reservado;
+};
+
+struct CategoriaBanco {
+    uint32_t offNombre, largoNombre;
+};
+
+struct CubetaBanco {
+    uint32_t inicio, cantidad;   // rango dentro del índice
+};
+
+struct RegistroPregunta {
+    uint32_t offPregunta, largoPregunta;
+    uint32_t offRespuesta, largoRespuesta;     // tal como se muestra
+    uint32_t offAceptadas, largoAceptadas;     // normalizadas, separadas por '\x1f'
+};
+
+// Preguntas incorporadas: se usan si no se indica --banco
+static const char *const kBancoIncorporado =
+    "videojuegos\tfacil\t¿Nombre del juego de Kratos?\tGod of War\n"
+    "videojuegos\tmedia\t¿Primer Call of Duty con Zombies?\tWorld at War|Call of Duty: World at War\n"
+    "videojuegos\tfacil\t¿Personaje con bigote de nintendo?\tMario|Super Mario\n"
+    "videojuegos\tfacil\t¿Color del traje de link tradicional?\tverde\n";
+
+static std::string normalizarRespuesta(std::string_view r) {
+    std::string norm(trim(r));
+    std::transform(norm.begin(), norm.end(), norm.begin(), ::tolower);
+    return norm;
+}
+
+static int dificultadDesdeTexto(std::string_view s) {
+    for (int d = 0; d < kDificultades; ++d)
+        if (igualesSinMayusculas(s, nombresDificultad[d]) || s == std::to_string(d + 1)) return d;
+    return -1;
+}
+
+// Convierte el TSV "categoria<TAB>dificultad<TAB>pregunta<TAB>respuesta[|alias...]"
+// (líneas vacías y las que empiezan con '#' se ignoran) a la imagen binaria.
+static bool compilarBanco(std::istream &in, std::string &imagen, std::string &error) {
+    struct Fuente { uint32_t categoria; int dificultad; RegistroPregunta r; };
+    std::vector<Fuente> fuentes;
+    std::vector<std::string> categorias;
+    std::string textos, linea;
+    auto agregarTexto = [&textos](std::string_view s, uint32_t &off, uint32_t &largo) {
+        off = textos.size();
+        largo = s.size();
+        textos.append(s);
+    };
+
+    for (int numLinea = 1; std::getline(in, linea); ++numLinea) {
+        if (!linea.empty() && linea.back() == '\r') linea.pop_back();
+        if (trim(linea).empty() || linea[0] == '#') continue;
+        std::string_view campos[4];
+        std::string_view resto = linea;
+        int n = 0;
+        for (; n < 4 && !resto.empty(); ++n) {
+            size_t tab = (n < 3 ? resto.find('\t') : std::string_view::npos);
+            campos[n] = trim(resto.substr(0, tab));
+            resto = (tab == std::string_view::npos ? std::string_view() : resto.substr(tab + 1));
+        }
+        int dificultad = (n == 4 ? dificultadDesdeTexto(campos[1]) : -1);
+        if (n < 4 || campos[0].empty() || campos[2].empty() || campos[3].empty() || dificultad < 0) {
+            error = "línea " + std::to_string(numLinea) + ": se esperaba categoria, dificultad (facil|media|dificil), pregunta y respuesta";
+            return false;
+        }
+
+        std::string categoria = normalizarRespuesta(campos[0]);
+        auto it = std::find(categorias.begin(), categorias.end(), categoria);
+        Fuente f;
+        f.categoria = it - categorias.begin();
+        if (it == categorias.end()) categorias.push_back(categoria);
+        f.dificultad = dificultad;
+
+        std::string_view respuestas = campos[3];
+        std::string_view oficial = trim(respuestas.substr(0, respuestas.find('|')));
+        agregarTexto(campos[2], f.r.offPregunta, f.r.largoPregunta);
+        agregarTexto(oficial, f.r.offRespuesta, f.r.largoRespuesta);
+        std::string aceptadas;
+        while (true) {
+            size_t barra = respuestas.find('|');
+            std::string alias = normalizarRespuesta(respuestas.substr(0, barra));
+            if (!alias.empty()) {
+                if (!aceptadas.empty()) aceptadas += '\x1f';
+                aceptadas += alias;
+            }
+            if (barra == std::string_view::npos) break;
+            respuestas.remove_prefix(barra + 1);
+        }
+        agregarTexto(aceptadas, f.r.offAceptadas, f.r.largoAceptadas);
+        fuentes.push_back(f);
+    }
+    if (fuentes.empty()) {
+        error = "el banco no tiene preguntas";
+        return false;
+    }
+
+    size_t offNombres = textos.size();
+    for (const auto &c : categorias) textos.append(c);
+
+    CabeceraBanco cab{};
+    std::memcpy(cab.magia, kMagiaBanco, sizeof(kMagiaBanco));
+    cab.numPreguntas = fuentes.size();
+    cab.numCategorias = categorias.size();
+    cab.tamTextos = textos.size();
+
+    std::vector<CategoriaBanco> tablaCategorias(categorias.size());
+    for (size_t i = 0; i < categorias.size(); ++i) {
+        tablaCategorias[i] = {uint32_t(offNombres), uint32_t(categorias[i].size())};
+        offNombres += categorias[i].size();
+    }
+
+    // Índice: ids ordenados de forma estable por (categoría, dificultad)
+    std::vector<uint32_t> indice(fuentes.size());
+    for (size_t i = 0; i < indice.size(); ++i) indice[i] = i;
+    auto clave = [&fuentes](uint32_t id) { return fuentes[id].categoria * kDificultades + fuentes[id].dificultad; };
+    std::stable_sort(indice.begin(), indice.end(), [&clave](uint32_t a, uint32_t b) { return clave(a) < clave(b); });
+    std::vector<CubetaBanco> cubetas(categorias.size() * kDificultades, CubetaBanco{0, 0});
+    for (size_t pos = indice.size(); pos-- > 0;) {
+        CubetaBanco &cb = cubetas[clave(indice[pos])];
+        cb.inicio = pos;
+        cb.cantidad++;
+    }
+    for (size_t i = 1; i < cubetas.size(); ++i)
+        if (cubetas[i].cantidad == 0) cubetas[i].inicio = cubetas[i - 1].inicio + cubetas[i - 1].cantidad;
+
+    auto escribir = [&imagen](const void *p, size_t n) { imagen.append(static_cast<const char *>(p), n); };
+    imagen.clear();
+    escribir(&cab, sizeof(cab));
+    escribir(tablaCategorias.data(), tablaCategorias.size() * sizeof(CategoriaBanco));
+    escribir(cubetas.data(), cubetas.size() * sizeof(CubetaBanco));
+    escribir(indice.data(), indice.size() * sizeof(uint32_t));
+    for (const auto &f : fuentes) escribir(&f.r, sizeof(f.r));
+    escribir(textos.data(), textos.size());
+    return true;
+}
+
+// Vista de solo lectura sobre una imagen del banco (mapeada o en memoria)
+class BancoTrivia {
+public:
+    BancoTrivia() = default;
+    BancoTrivia(const BancoTrivia &) = delete;
+    BancoTrivia &operator=(const BancoTrivia &) = delete;
+    ~BancoTrivia() { if (mapa) munmap(mapa, tamMapa); }
+
+    // Mapea el archivo compilado. Solo se valida la cabecera y el tamaño total;
+    // cada acceso a un texto se acota, así que no se recorre el archivo.
+    bool abrir(const std::string &ruta, std::string &error) {
+        int fd = open(ruta.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            error = ruta + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        void *p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            error = ruta + ": no se pudo mapear";
+            return false;
+        }
+        madvise(p, st.st_size, MADV_RANDOM);
+        mapa = p;
+        tamMapa = st.st_size;
+        if (!usar(static_cast<const char *>(p), st.st_size)) {
+            error = ruta + ": no es un banco de trivia válido (use --compilar-banco)";
+            return false;
+        }
+        return true;
+    }
+
+    // Adopta una imagen en memoria (banco incorporado)
+    bool adoptar(std::string imagen) {
+        propia = std::move(imagen);
+        return usar(propia.data(), propia.size());
+    }
+
+    uint32_t numPreguntas() const { return cab->numPreguntas; }
+    uint32_t numCategorias() const { return cab->numCategorias; }
+    std::string_view categoria(uint32_t i) const { return texto(categorias[i].offNombre, categorias[i].largoNombre); }
+
+    int buscarCategoria(std::string_view nombre) const {
+        for (uint32_t i = 0; i < numCategorias(); ++i)
+            if (igualesSinMayusculas(categoria(i), nombre)) return i;
+        return -1;
+    }
+
+    std::string_view pregunta(uint32_t id) const { return texto(registros[id].offPregunta, registros[id].largoPregunta); }
+    std::string_view respuesta(uint32_t id) const { return texto(registros[id].offRespuesta, registros[id].largoRespuesta); }
+
+    // Compara la respuesta recibida contra la oficial y sus alias, sin copiar
+    bool acepta(uint32_t id, std::string_view recibida) const {
+        std::string_view aceptadas = texto(registros[id].offAceptadas, registros[id].largoAceptadas);
+        recibida = trim(recibida);
+        while (true) {
+            size_t sep = aceptadas.find('\x1f');
+            if (igualesSinMayusculas(recibida, aceptadas.substr(0, sep))) return true;
+            if (sep == std::string_view::npos) return false;
+            aceptadas.remove_prefix(sep + 1);
+        }
+    }
+
+    // Hasta k preguntas distintas al azar, filtrando por categoría y/o
+    // dificultad (-1 = cualquiera). Algoritmo de Floyd sobre los rangos del
+    // índice: O(k) sorteos, sin recorrer el banco. Se devuelven barajadas, así
+    // que ni un filtro ni un banco de k preguntas o menos repiten el orden.
+    std::vector<uint32_t> muestrear(size_t k, int cat, int dif, std::mt19937 &gen) const {
+        std::vector<CubetaBanco> rangos;
+        uint32_t total = 0;
+        for (uint32_t c = 0; c < numCategorias(); ++c) {
+            if (cat >= 0 && (int)c != cat) continue;
+            for (int d = 0; d < kDificultades; ++d) {
+                if (dif >= 0 && d != dif) continue;
+                const CubetaBanco &cb = cubetas[c * kDificultades + d];
+                if (cb.cantidad == 0 || cb.inicio > numPreguntas() || cb.cantidad > numPreguntas() - cb.inicio) continue;
+                if (!rangos.empty() && rangos.back().inicio + rangos.back().cantidad == cb.inicio)
+                    rangos.back().cantidad += cb.cantidad; // contiguas: un solo rango
+                else
+                    rangos.push_back(cb);
+                total += cb.cantidad;
+            }
+        }
+        k = std::min<size_t>(k, total);
+        std::vector<uint32_t> posiciones;
+        std::unordered_set<uint32_t> elegidas;
+        posiciones.reserve(k);
+        elegidas.reserve(k);
+        for (uint32_t j = total - k; j < total; ++j) {
+            uint32_t r = std::uniform_int_distribution<uint32_t>(0, j)(gen);
+            uint32_t pos = elegidas.insert(r).second ? r : j;
+            if (pos == j) elegidas.insert(j);
+            posiciones.push_back(pos);
+        }
+        std::sort(posiciones.begin(), posiciones.end()); // para recorrer los rangos en orden
+        std::vector<uint32_t> ids;
+        ids.reserve(k);
+        size_t rango = 0;
+        uint32_t saltadas = 0;
+        for (uint32_t pos : posiciones) {
+            while (pos - saltadas >= rangos[rango].cantidad) saltadas += rangos[rango++].cantidad;
+            uint32_t id = indice[rangos[rango].inicio + (pos - saltadas)];
+            if (id < numPreguntas()) ids.push_back(id);
+        }
+        std::shuffle(ids.begin(), ids.end(), gen);
+        return ids;
+    }
+
+private:
+    const char *base = nullptr;
+    const CabeceraBanco *cab = nullptr;
+    const CategoriaBanco *categorias = nullptr;
+    const CubetaBanco *cubetas = nullptr;
+    const uint32_t *indice = nullptr;
+    const RegistroPregunta *registros = nullptr;
+    const char *textos = nullptr;
+    void *mapa = nullptr;
+    size_t tamMapa = 0;
+    std::string propia;
+
+    bool usar(const char *datos, size_t tam) {
+        if (tam < sizeof(CabeceraBanco)) return false;
+        const CabeceraBanco *c = reinterpret_cast<const CabeceraBanco *>(datos);
+        if (std::memcmp(c->magia, kMagiaBanco, sizeof(kMagiaBanco)) != 0 || c->numPreguntas == 0) return false;
+        uint64_t esperado = sizeof(CabeceraBanco) + uint64_t(c->numCategorias) * sizeof(CategoriaBanco)
+                          + uint64_t(c->numCategorias) * kDificultades * sizeof(CubetaBanco)
+                          + uint64_t(c->numPreguntas) * (sizeof(uint32_t) + sizeof(RegistroPregunta)) + c->tamTextos;
+        if (esperado != tam) return false;
+        base = datos;
+        cab = c;
+        categorias = reinterpret_cast<const CategoriaBanco *>(cab + 1);
+        cubetas = reinterpret_cast<const CubetaBanco *>(categorias + cab->numCategorias);
+        indice = reinterpret_cast<const uint32_t *>(cubetas + cab->numCategorias * kDificultades);
+        registros = reinterpret_cast<const RegistroPregunta *>(indice + cab->numPreguntas);
+        textos = reinterpret_cast<const char *>(registros + cab->numPreguntas);
+        return true;
+    }
+
+    std::string_view texto(uint32_t off, uint32_t largo) const {
+        if (off > cab->tamTextos || largo > cab->tamTextos - off) return std::string_view();
+        return std::string_view(textos + off, largo);
+    }
+};
+
+static BancoTrivia bancoTrivia;
+
+static const auto kTiempoPregunta = std::chrono::milliseconds(10000);
+static const auto kPausaSinRespuesta = std::chrono::milliseconds(1000);
+
+// Textos de la trivia. Las reglas dependen de la cantidad de preguntas: se
+// arman una vez para la cantidad configurada y solo se rehacen si el filtro
+// pedido deja menos preguntas.
+static Mensaje armarReglasTrivia(size_t n) {
+    return hacerMensaje(
+        "Inicia Trivia! Responde lo más rápido posible.\n"
+        "Reglas: " + std::to_string(n) + " preguntas. El primer jugador en enviar la respuesta correcta obtiene 1 punto por pregunta.\n"
+        "Tiempo por pregunta: 10 segundos.\n");
+}
+static Mensaje reglasTrivia;   // para config.preguntasTrivia, se arma en main
+static const Mensaje kEscribeRespuesta = hacerMensaje("Escribe tu respuesta ahora (10s)\n");
+static const Mensaje kNadieRespondio = hacerMensaje("Nadie respondió correctamente en tiempo.\n");
+
+// Pregunta abierta. Es inmutable salvo el reclamo del ganador, así que quien
+// responde solo necesita leerla: comparar la respuesta no toma ningún lock.
+struct PreguntaAbierta {
+    static constexpr uint64_t kSinReclamo = UINT64_MAX;
+    static constexpr uint64_t kCerrada = 0;
+
+    uint32_t id;                         // en el banco
+    Reloj::time_point apertura;
+    // (µs desde la apertura << 32) | clientId; el menor gana
+    std::atomic<uint64_t> reclamo{kSinReclamo};
+
+    PreguntaAbierta(uint32_t id, Reloj::time_point apertura) : id(id), apertura(apertura) {}
+
+    // Reclama la pregunta para un acierto recibido en 'recibido'. Un único CAS
+    // en el caso normal; solo reintenta si otro acierto se cruzó. Devuelve true
+    // si fue el primer reclamo (hay que programar la adjudicación).
+    bool reclamar(int clientId, Reloj::time_point recibido) {
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(recibido - apertura).count();
+        uint64_t propio = (uint64_t(std::clamp<int64_t>(us, 0, UINT32_MAX - 1)) << 32) | uint32_t(clientId);
+        uint64_t actual = reclamo.load(std::memory_order_acquire);
+        while (propio < actual) {
+            if (reclamo.compare_exchange_weak(actual, propio, std::memory_order_acq_rel, std::memory_order_acquire))
+                return actual == kSinReclamo;
+        }
+        return false;
+    }
+
+    // Cierra la pregunta a nuevos reclamos; devuelve el ganador o -1
+    int cerrar() {
+        uint64_t final = reclamo.exchange(kCerrada, std::memory_order_acq_rel);
+        return final == kSinReclamo || final == kCerrada ? -1 : int(uint32_t(final));
+    }
+};
+
+// Puntajes repartidos en fragmentos por clientId, cada uno en su línea de caché
+struct PuntajesTrivia {
+    static constexpr size_t kFragmentos = 16;
+    struct alignas(64) Fragmento {
+        std::mutex m;
+        std::unordered_map<int,int> puntos;   // clientId -> score
+    };
+    Fragmento fragmentos[kFragmentos];
+
+    Fragmento &de(int clientId) { return fragmentos[uint32_t(clientId) % kFragmentos]; }
+
+    void sumar(int clientId) {
+        Fragmento &f = de(clientId);
+        std::lock_guard<std::mutex> lk(f.m);
+        f.puntos[clientId]++;
+    }
+
+    int leer(int clientId) {
+        Fragmento &f = de(clientId);
+        std::lock_guard<std::mutex> lk(f.m);
+        auto it = f.puntos.find(clientId);
+        return it != f.puntos.end() ? it->second : 0;
+    }
+};
+
+// Una partida de trivia como máquina de estados dirigida por temporizadores.
+// No tiene hilo propio: avanza con las respuestas y los vencimientos del reactor.
+struct SesionTrivia {
+    std::vector<uint32_t> preguntas;      // ids en el banco, sorteados al iniciar
+    size_t pregunta = 0;                  // posición de la pregunta en curso
+    std::shared_ptr<PreguntaAbierta> abierta;  // se publica con atomic_store
+    IdTemporizador temporizador = 0;
+    PuntajesTrivia puntajes;
+    std::shared_ptr<Sala> sala;           // la partida solo involucra a sus miembros
+    Reactor *dueno = nullptr;             // reactor donde corren sus temporizadores
+
+    std::shared_ptr<PreguntaAbierta> preguntaAbierta() const { return std::atomic_load(&abierta); }
+};
+
+static void abrirPregunta(const std::shared_ptr<SesionTrivia> &s);
+
+static void terminarTrivia(const std::shared_ptr<SesionTrivia> &s) {
+    // Resultado final
+    Sala &sala = *s->sala;
+    auto miembros = sala.leerMiembros();
+    std::ostringstream oss;
+    oss << "Resultados de la Trivia:\n";
+    for (auto &c : *miembros) oss << c->nombre << ": " << s->puntajes.leer(c->id) << "\n";
+    broadcastMessage(sala, oss.str());
+
+    // Avisar que la partida terminó y devolver al menu principal
+    broadcastMessage(sala, kFinPartida);
+    std::shared_ptr<SesionTrivia> esperada = s;
+    std::atomic_compare_exchange_strong(&sala.trivia, &esperada, std::shared_ptr<SesionTrivia>());
+    setSalaMenuState(sala, true);
+    for (auto &c : *miembros) sendMenuToClient(c);
+}
+
+// Cierra la pregunta en curso y anuncia al ganador, si hubo acierto a tiempo
+static void cerrarPregunta(const std::shared_ptr<SesionTrivia> &s) {
+    auto p = s->preguntaAbierta();
+    if (!p) return;
+    std::atomic_store(&s->abierta, std::shared_ptr<PreguntaAbierta>());
+    int ganador = p->cerrar();
+    cancelarTemporizador(s->temporizador);
+    std::string_view original = bancoTrivia.respuesta(p->id);
+    s->pregunta++;
+
+    if (ganador != -1) {
+        s->puntajes.sumar(ganador);
+        std::string texto = "Respuesta correcta de: " + getClientNameById(ganador) + " (";
+        texto.append(original).append(")\n");
+        broadcastMessage(*s->sala, hacerMensaje(std::move(texto)));
+        // Sin espera: la siguiente pregunta sale en el mismo ciclo del reactor
+        if (s->pregunta < s->preguntas.size()) abrirPregunta(s);
+        else terminarTrivia(s);
+        return;
+    }
+
+    std::string texto = "Respuesta correcta: ";
+    texto.append(original).append("\n");
+    broadcastMessage(*s->sala, hacerMensaje(std::move(texto)));
+    broadcastMessage(*s->sala, kNadieRespondio);
+    // breve pausa antes de la siguiente pregunta
+    s->temporizador = programarTemporizador(kPausaSinRespuesta, [s]{
+        if (s->pregunta < s->preguntas.size()) abrirPregunta(s);
+        else terminarTrivia(s);
+    });
+}
+
+static void abrirPregunta(const std::shared_ptr<SesionTrivia> &s) {
+    uint32_t id = s->preguntas[s->pregunta];
+    std::string texto = "Pregunta: ";
+    texto.append(bancoTrivia.pregunta(id)).append("\n");
+    broadcastMessage(*s->sala, hacerMensaje(std::move(texto)));
+    // Informar a los clientes que tienen 10 segundos para responder
+    broadcastMessage(*s->sala, kEscribeRespuesta);
+    std::atomic_store(&s->abierta, std::make_shared<PreguntaAbierta>(id, Reloj::now()));
+    s->temporizador = programarTemporizador(kTiempoPregunta, [s]{ cerrarPregunta(s); });
+}
+
+// Inicia la trivia de la sala con las preguntas sorteadas. Devuelve false si
+// ya hay una en curso.
+static bool iniciarTrivia(const std::shared_ptr<Sala> &sala, std::vector<uint32_t> preguntas) {
+    auto s = std::make_shared<SesionTrivia>();
+    s->preguntas = std::move(preguntas);
+    s->sala = sala;
+    s->dueno = reactorActual;
+    // Miembros en otros reactores pueden iniciarla a la vez: gana uno solo
+    std::shared_ptr<SesionTrivia> ninguna;
+    if (!std::atomic_compare_exchange_strong(&sala->trivia, &ninguna, s)) return false;
+    // marcar a los miembros de la sala como fuera del menu (en juego)
+    setSalaMenuState(*sala, false);
+
+    // Enviar reglas básicas de la trivia
+    bool completa = s->preguntas.size() == std::min<size_t>(config.preguntasTrivia, bancoTrivia.numPreguntas());
+    broadcastMessage(*sala, completa ? reglasTrivia : armarReglasTrivia(s->preguntas.size()));
+
+    abrirPregunta(s);
+    return true;
+}
+
+// Respuesta de un cliente mientras hay una pregunta abierta. Se compara contra
+// la pregunta publicada sin tomar locks; el primer acierto reclama la pregunta
+// y deja la adjudicación en el buzón del reactor de la partida, que la corre
+// al final de su iteración. Los aciertos que llegan antes (del mismo lote de
+// eventos o de otros reactores) compiten por hora de recepción, sin sumar
+// ninguna espera.
+static void responderTrivia(const std::shared_ptr<SesionTrivia> &s, int clientId, std::string_view msg,
+                            Reloj::time_point recibido) {
+    auto p = s->preguntaAbierta();
+    if (!p) return;
+    if (!bancoTrivia.acepta(p->id, msg)) return;
+    if (!p->reclamar(clientId, recibido)) return;
+    s->dueno->publicar([s, p]{
+        if (s->preguntaAbierta() != p) return; // ya se cerró por tiempo
+        cerrarPregunta(s);
+    });
+}
+
+void crearSocket(int &sock) {
+    if ((sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+        std::cerr << "Error Creación de Socket" << std::endl;
+        exit(1);
+    }
+}
+
+void configurarServidor(int socket, struct sockaddr_in &conf) {
+    // Asegurar que la estructura esté inicializada a cero
+    std::memset(&conf, 0, sizeof(conf));
+    // Permitir reusar la dirección rápidamente (evita EADDRINUSE en reinicios rápidos)
+    int opt = 1;
+    if (setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        std::cerr << "Warning: setsockopt(SO_REUSEADDR) falló: " << std::strerror(errno) << std::endl;
+    }
+    // Con varios reactores cada uno tiene su socket en el mismo puerto y el
+    // kernel reparte las conexiones entrantes entre ellos
+    if (config.reactores > 1 && setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        std::cerr << "Error setsockopt(SO_REUSEPORT): " << std::strerror(errno) << std::endl;
+        exit(1);
+    }
+    conf.sin_family = AF_INET;
+    conf.sin_addr.s_addr = htonl(INADDR_ANY);
+    conf.sin_port = htons(PORT);
+
+    if ((bind(socket, (struct sockaddr *)&conf, sizeof(conf))) < 0) {
+        std::cerr << "Error de enlace: " << std::strerror(errno) << std::endl;
+        exit(1);
+    }
+}
+
+// Socket de escucha del puerto de administración, solo en 127.0.0.1
+static int crearSocketAdmin(int puerto) {
+    int sock;
+    crearSocket(sock);
+    int opt = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    struct sockaddr_in conf;
+    std::memset(&conf, 0, sizeof(conf));
+    conf.sin_family = AF_INET;
+    conf.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    conf.sin_port = htons(puerto);
+    if (bind(sock, (struct sockaddr *)&conf, sizeof(conf)) < 0 || listen(sock, 16) < 0) {
+        std::cerr << "Warning: puerto de administración " << puerto << " no disponible: " << std::strerror(errno) << std::endl;
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// La cola de accept no depende de nClientes: tiene que absorber ráfagas de
+// conexiones, y el máximo de clientes se aplica al aceptarlas
+void escucharClientes(int sock) {
+    if (listen(sock, SOMAXCONN) < 0) {
+        std::cerr << "Error listening" << std::endl;
+        exit(1);
+    }
+}
+
+// Acepta una conexión pendiente (socket de escucha no bloqueante).
+// Devuelve false cuando ya no quedan conexiones en la cola de accept.
+bool aceptarConexion(int &sockNuevo, int sock, struct sockaddr_in &conf) {
+    socklen_t tamannoConf = sizeof(conf);
+
+    while ((sockNuevo = accept4(sock, (struct sockaddr *)&conf, &tamannoConf, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) {
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+            std::cerr << "Error accepting: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Piedra-Papel-Tijera structures
+// Toda la partida vive en el hilo del reactor: no necesita mutex propio.
+struct PvPGame {
+    enum class Fase { Movimientos, Revancha };
+
+    PvPGame() { partidasPvP++; }
+    ~PvPGame() { partidasPvP--; }
+
+    int player1Id = -1;
+    int player2Id = -1;
+    int player1Sock = -1;
+    int player2Sock = -1;
+    std::string player1Name;
+    std::string player2Name;
+    std::string move1;
+    std::string move2;
+    Fase fase = Fase::Movimientos;
+    bool listo[2] = {false, false};       // el jugador ya respondió en esta fase
+    std::deque<std::string> pendiente[2]; // mensajes para la fase siguiente
+};
+
+// Emparejamiento RPS PvP. Cada jugador en espera tiene un ticket cuyo estado
+// cambia con un CAS: cancelar (timeout o desconexión) es O(1) y no toca la
+// cola; la entrada muerta se descarta en la siguiente pasada.
+struct TicketEmparejamiento {
+    enum Estado : int { Esperando, Emparejado, Cancelado };
+
+    std::weak_ptr<Conexion> conn;
+    int rating = 1000;
+    Reloj::time_point llegada;
+    std::atomic<int> estado{Esperando};
+    IdTemporizador espera = 0;            // vencimiento de la espera de rival
+    bool avisado = false;                 // ya se le dijo que espera rival
+    std::deque<std::string> pendiente;    // mensajes recibidos mientras espera
+
+    bool cambiar(int de, int a) { return estado.compare_exchange_strong(de, a); }
+};
+
+// Entradas que un jugador adelanta mientras espera rival o la siguiente fase de
+// la partida. Solo importa la próxima jugada, así que se guardan pocas y cortas:
+// lo que pase de ahí se descarta con un aviso. Sin tope, un cliente que escribe
+// sin parar haría crecer la memoria del servidor sin pasar por ningún límite.
+static constexpr size_t kMaxAdelantadas = 2;
+static constexpr size_t kMaxBytesAdelantadas = 256;
+
+static void adelantarEntrada(Conexion &c, std::deque<std::string> &cola, std::string_view msg) {
+    size_t bytes = msg.size();
+    for (const std::string &m : cola) bytes += m.size();
+    if (cola.size() >= kMaxAdelantadas || bytes > kMaxBytesAdelantadas) {
+        sendToClient(c.sock, "Entrada ignorada: ya tienes una jugada en espera\n");
+        return;
+    }
+    cola.emplace_back(msg);
+}
+
+// Cola de espera fragmentada: por tramo de rating, o por id del cliente si se
+// empareja por llegada. Encolar solo bloquea un fragmento. El reactor empareja
+// en lote al final de cada iteración: vacía cada fragmento de una vez, forma
+// pares dentro de él y luego cruza los sobrantes entre fragmentos vecinos,
+// ampliando la tolerancia de rating a medida que pasa el tiempo de espera.
+class ColaEmparejamiento {
+public:
+    using Ticket = std::shared_ptr<TicketEmparejamiento>;
+
+    void encolar(const Ticket &t, int clientId) {
+        Fragmento &f = fragmentos[fragmentoDe(*t, clientId)];
+        {
+            auto lock = bloquear(f.mtx, LockMedido::Emparejamiento);
+            f.cola.push_back(t);
+        }
+        hayNuevos = true;
+        // Los pares se forman en el primer reactor
+        if (reactorActual != reactores[0].get()) reactores[0]->despertar();
+    }
+
+    static bool cancelar(TicketEmparejamiento &t) {
+        return t.cambiar(TicketEmparejamiento::Esperando, TicketEmparejamiento::Cancelado);
+    }
+
+    // Forma todos los pares posibles; deja en 'enEspera' los tickets que
+    // quedaron sin pareja por primera vez. Solo desde el reactor.
+    std::vector<std::pair<Ticket, Ticket>> emparejar(std::vector<Ticket> &enEspera) {
+        std::vector<std::pair<Ticket, Ticket>> pares;
+        Ticket sobrante[kFragmentos];
+        auto ahora = Reloj::now();
+        hayNuevos = false;
+        esperando = 0;
+
+        for (int i = 0; i < kFragmentos; ++i) {
+            std::deque<Ticket> tomados;
+            {
+                auto lock = bloquear(fragmentos[i].mtx, LockMedido::Emparejamiento);
+                tomados.swap(fragmentos[i].cola);
+            }
+            Ticket previo;
+            for (auto &t : tomados) {
+                if (t->estado.load() != TicketEmparejamiento::Esperando) continue;
+                if (!previo) { previo = t; continue; }
+                if (formarPar(previo, t, pares)) previo.reset();
+                else if (previo->estado.load() != TicketEmparejamiento::Esperando) previo = t;
+            }
+            sobrante[i] = previo;
+        }
+
+        // Sobrantes: a lo más uno por fragmento, se cruzan con el vecino más cercano
+        int candidato = -1;
+        for (int i = 0; i < kFragmentos; ++i) {
+            if (!sobrante[i]) continue;
+            if (candidato >= 0 && i - candidato <= std::min(ventana(*sobrante[candidato], ahora), ventana(*sobrante[i], ahora))
+                && formarPar(sobrante[candidato], sobrante[i], pares)) {
+                sobrante[candidato].reset();
+                sobrante[i].reset();
+                candidato = -1;
+                continue;
+            }
+            if (candidato >= 0 && sobrante[candidato]->estado.load() != TicketEmparejamiento::Esperando)
+                sobrante[candidato].reset();
+            candidato = i;
+        }
+
+        // Los que siguen esperando vuelven al frente de su fragmento
+        for (int i = 0; i < kFragmentos; ++i) {
+            if (!sobrante[i] || sobrante[i]->estado.load() != TicketEmparejamiento::Esperando) continue;
+            auto lock = bloquear(fragmentos[i].mtx, LockMedido::Emparejamiento);
+            fragmentos[i].cola.push_front(sobrante[i]);
+            esperando++;
+            if (!sobrante[i]->avisado) {
+                sobrante[i]->avisado = true;
+                enEspera.push_back(sobrante[i]);
+            }
+        }
+        return pares;
+    }
+
+    // Fuerza una pasada aunque no haya llegado nadie (ventanas que se amplían)
+    void despertar() { hayNuevos = true; }
+
+    bool nuevos() const { return hayNuevos.load(); }
+    size_t sinPareja() const { return esperando; }
+
+private:
+    static constexpr int kFragmentos = 32;
+    static constexpr int kTramoRating = 100;
+
+    struct Fragmento {
+        std::mutex mtx;
+        std::deque<Ticket> cola;
+    };
+
+    Fragmento fragmentos[kFragmentos];
+    std::atomic<bool> hayNuevos{false};
+    std::atomic<size_t> esperando{0};     // sobrantes tras la última pasada
+
+    static int fragmentoDe(const TicketEmparejamiento &t, int clientId) {
+        if (!config.emparejarPorRating) return (unsigned)clientId % kFragmentos;
+        return std::clamp(t.rating / kTramoRating, 0, kFragmentos - 1);
+    }
+
+    // Distancia máxima (en fragmentos) aceptada para este ticket: por llegada
+    // cualquiera; por rating crece un tramo cada 5 s de espera.
+    static int ventana(const TicketEmparejamiento &t, Reloj::time_point ahora) {
+        if (!config.emparejarPorRating) return kFragmentos;
+        return 1 + (int)std::chrono::duration_cast<std::chrono::seconds>(ahora - t.llegada).count() / 5;
+    }
+
+    static bool formarPar(const Ticket &a, const Ticket &b, std::vector<std::pair<Ticket, Ticket>> &pares) {
+        if (!a->cambiar(TicketEmparejamiento::Esperando, TicketEmparejamiento::Emparejado)) return false;
+        if (!b->cambiar(TicketEmparejamiento::Esperando, TicketEmparejamiento::Emparejado)) {
+            a->cambiar(TicketEmparejamiento::Emparejado, TicketEmparejamiento::Esperando);
+            return false;
+        }
+        pares.emplace_back(a, b);
+        return true;
+    }
+};
+
+static ColaEmparejamiento emparejamiento;
+static IdTemporizador revisionEmparejamiento = 0; // pasada periódica (rating)
+
+// Normaliza el movimiento (minúsculas) y acepta varias formas
+std::string normalizeMove(std::string_view m) {
+    std::string_view s = trim(m);
+    if (igualesSinMayusculas(s, "piedra") || igualesSinMayusculas(s, "p")) return "piedra";
+    if (igualesSinMayusculas(s, "papel") || igualesSinMayusculas(s, "pa")) return "papel";
+    if (igualesSinMayusculas(s, "tijera") || igualesSinMayusculas(s, "tijeras") || igualesSinMayusculas(s, "t")) return "tijera";
+    std::string otro(s);
+    std::transform(otro.begin(), otro.end(), otro.begin(), ::tolower);
+    return otro;
+}
+
+// Decide ganador: 0 empate, 1 player1 gana, 2 player2 gana
+int decideRPS(const std::string &a, const std::string &b) {
+    if (a == b) return 0;
+    if (a == "piedra" && b == "tijera") return 1;
+    if (a == "tijera" && b == "papel") return 1;
+    if (a == "papel" && b == "piedra") return 1;
+    return 2;
+}
+
+// Actualiza el Elo de ambos jugadores tras una ronda (res como decideRPS)
+static void actualizarRating(Conexion &a, Conexion &b, int res) {
+    const double k = 32.0;
+    double esperadoA = 1.0 / (1.0 + std::pow(10.0, (b.rating - a.rating) / 400.0));
+    double resultadoA = (res == 1 ? 1.0 : (res == 0 ? 0.5 : 0.0));
+    int delta = (int)std::lround(k * (resultadoA - esperadoA));
+    a.rating += delta;
+    b.rating -= delta;
+}
+
+static bool esRespuestaSi(std::string_view msg) {
+    std::string_view ans = trim(msg);
+    return igualesSinMayusculas(ans, "si") || igualesSinMayusculas(ans, "s")
+        || igualesSinMayusculas(ans, "yes") || igualesSinMayusculas(ans, "y");
+}
+
+void procesarMensaje(Conexion &c, std::string_view msg);
+
+static void volverAlMenu(Conexion &c) {
+    c.estado = EstadoConexion::Menu;
+    c.partida.reset();
+    setClientMenuState(c.id, true);
+    sendMenuToClient(c.sock);
+}
+
+static const Mensaje kPromptMaquina = hacerMensaje("Elegiste jugar contra la máquina. Envía 'piedra', 'papel' o 'tijera' (o escribe CANCEL para salir)\n");
+
+// Juego vs máquina
+void playRPSvsMachine(Conexion &c) {
+    // marcar cliente como en juego (fuera del menu)
+    setClientMenuState(c.id, false);
+    c.estado = EstadoConexion::RPSMaquinaMovimiento;
+    c.intentos = 0;
+    sendToClient(c.sock, kPromptMaquina);
+}
+
+static void rpsMaquinaMovimiento(Conexion &c, std::string_view msg) {
+    const int maxAttempts = 5;
+    thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<int> dist(0,2);
+
+    std::string_view raw = trim(msg);
+    if (igualesSinMayusculas(raw, "cancel")) {
+        sendToClient(c.sock, "Partida cancelada por el usuario.\n");
+        volverAlMenu(c);
+        return;
+    }
+    std::string move = normalizeMove(raw);
+    if (!(move == "piedra" || move == "papel" || move == "tijera")) {
+        sendToClient(c.sock, "Movimiento inválido. Intenta de nuevo o escribe CANCEL para salir.\n");
+        if (++c.intentos >= maxAttempts) {
+            sendToClient(c.sock, "No se recibió un movimiento válido. Se cancela la partida.\n");
+            volverAlMenu(c);
+        } else {
+            sendToClient(c.sock, kPromptMaquina);
+        }
+        return;
+    }
+
+    // Generar movimiento de la máquina
+    int r = dist(gen);
+    std::string machine = (r==0?"piedra":(r==1?"papel":"tijera"));
+
+    int res = decideRPS(move, machine);
+    std::string resultado;
+    if (res == 0) resultado = "Empate! Ambos eligieron " + move + "\n";
+    else if (res == 1) resultado = "Ganaste! Tu " + move + " vence a " + machine + "\n";
+    else resultado = "Perdiste. Tu " + move + " pierde contra " + machine + "\n";
+
+    sendToClient(c.sock, resultado);
+    // Anunciar resultado a la sala (RPS vs máquina)
+    {
+        std::string summary = "RPS - ";
+        summary += c.nombre + " (" + move + ") vs Máquina (" + machine + "): ";
+        if (res == 0) summary += "Empate\n";
+        else if (res == 1) summary += c.nombre + " gana\n";
+        else summary += "Máquina gana\n";
+        broadcastMessage(*c.sala, summary);
+    }
+
+    if (res == 0) {
+        // Empate: ofrecer volver a jugar
+        sendToClient(c.sock, "Empate! ¿Jugar otra ronda? (si/no)\n");
+        c.estado = EstadoConexion::RPSMaquinaRevancha;
+    } else {
+        // Win or lose: finalizar y volver al menu
+        sendToClient(c.sock, kFinPartida);
+        volverAlMenu(c);
+    }
+}
+
+static void rpsMaquinaRevancha(Conexion &c, std::string_view msg) {
+    if (esRespuestaSi(msg)) {
+        // jugar otra ronda
+        c.intentos = 0;
+        c.estado = EstadoConexion::RPSMaquinaMovimiento;
+        sendToClient(c.sock, kPromptMaquina);
+    } else {
+        sendToClient(c.sock, kFinPartida);
+        volverAlMenu(c);
+    }
+}
+
+static void enviarPromptsPvP(PvPGame &g) {
+    sendToClient(g.player1Sock, "Jugador 1 (" + g.player1Name + "), elige: piedra, papel o tijera (o escribe CANCEL para salir)\n");
+    sendToClient(g.player2Sock, "Jugador 2 (" + g.player2Name + "), elige: piedra, papel o tijera (o escribe CANCEL para salir)\n");
+}
+
+static void enviarPreguntaRevancha(PvPGame &g) {
+    sendToClient(g.player1Sock, "¿Jugar otra ronda, " + g.player1Name + "? (si/no)\n");
+    sendToClient(g.player2Sock, "¿Jugar otra ronda, " + g.player2Name + "? (si/no)\n");
+}
+
+// Devuelve ambos jugadores al menú. Los mensajes que llegaron adelantados se
+// procesan ahora como lo haría el bucle principal.
+static void terminarPvP(PvPGame &g) {
+    for (int sock : {g.player1Sock, g.player2Sock}) {
+        Conexion *c = buscarConexion(sock);
+        if (!c || c->partida.get() != &g) continue;
+        std::deque<std::string> pendientes;
+        pendientes.swap(g.pendiente[c->jugador]);
+        auto partida = c->partida; // mantener viva la partida mientras se limpia
+        volverAlMenu(*c);
+        for (auto &m : pendientes) procesarMensaje(*c, m);
+    }
+}
+
+static void vencerEsperaPvP(const std::shared_ptr<TicketEmparejamiento> &t);
+static void migrarConexion(Conexion &c, Reactor &destino, std::function<void(Conexion &)> alLlegar);
+
+static constexpr std::chrono::seconds kEsperaRival{30};
+
+// Entra a la cola de emparejamiento; la pareja se forma al final de la iteración
+void playRPSvsPlayer(Conexion &c) {
+    auto t = std::make_shared<TicketEmparejamiento>();
+    t->conn = c.shared_from_this();
+    t->rating = c.rating;
+    t->llegada = Reloj::now();
+    t->espera = programarTemporizador(kEsperaRival, [t]{ vencerEsperaPvP(t); });
+    c.ticket = t;
+    c.estado = EstadoConexion::RPSEsperandoRival;
+    emparejamiento.encolar(t, c.id);
+}
+
+// Crea la partida para dos jugadores emparejados
+static void iniciarPvP(Conexion &p1, Conexion &p2) {
+    auto mygame = std::make_shared<PvPGame>();
+    mygame->player1Id = p1.id;
+    mygame->player1Sock = p1.sock;
+    mygame->player1Name = p1.nombre;
+    mygame->player2Id = p2.id;
+    mygame->player2Sock = p2.sock;
+    mygame->player2Name = p2.nombre;
+
+    std::deque<std::string> pendientes[2];
+    Conexion *jugadores[2] = {&p1, &p2};
+    for (int i = 0; i < 2; ++i) {
+        Conexion &c = *jugadores[i];
+        pendientes[i].swap(c.ticket->pendiente);
+        c.ticket.reset();
+        c.partida = mygame;
+        c.jugador = i;
+        c.estado = EstadoConexion::RPSJugador;
+    }
+
+    // Both players are matched
+    setClientMenuState(mygame->player1Id, false);
+    setClientMenuState(mygame->player2Id, false);
+    enviarPromptsPvP(*mygame);
+
+    // Lo que escribieron mientras esperaban son sus primeros movimientos
+    for (int i = 0; i < 2; ++i)
+        for (auto &m : pendientes[i]) procesarMensaje(*jugadores[i], m);
+}
+
+// Quita al jugador de la espera y lo devuelve al menú, procesando lo que envió
+static void salirDeEspera(Conexion &c) {
+    std::deque<std::string> pendientes;
+    pendientes.swap(c.ticket->pendiente);
+    c.ticket.reset();
+    volverAlMenu(c);
+    for (auto &m : pendientes) procesarMensaje(c, m);
+}
+
+// Vence la espera del jugador si nadie se unió a tiempo
+static void vencerEsperaPvP(const std::shared_ptr<TicketEmparejamiento> &t) {
+    if (!ColaEmparejamiento::cancelar(*t)) return;
+    std::shared_ptr<Conexion> c = t->conn.lock();
+    if (!c || c->cerrando || c->ticket != t) return;
+    sendToClient(c, "Nadie se unió. Volviendo al menú.\n");
+    salirDeEspera(*c);
+}
+
+// El par no se concretó: el jugador vuelve a la cola con el resto de su
+// espera (en el reactor dueño de la conexión)
+static void devolverACola(Conexion &c, const std::shared_ptr<TicketEmparejamiento> &t) {
+    if (c.cerrando || c.ticket != t) return;
+    if (!t->cambiar(TicketEmparejamiento::Emparejado, TicketEmparejamiento::Esperando)) return;
+    // Su temporizador pudo vencer mientras estaba emparejado: se rearma
+    cancelarTemporizador(t->espera);
+    auto resta = std::chrono::duration_cast<std::chrono::milliseconds>(t->llegada + kEsperaRival - Reloj::now());
+    t->espera = programarTemporizador(std::max(resta, std::chrono::milliseconds(1)), [t]{ vencerEsperaPvP(t); });
+    emparejamiento.encolar(t, c.id);
+}
+
+static void devolverACola(const std::shared_ptr<TicketEmparejamiento> &t) {
+    if (std::shared_ptr<Conexion> c = t->conn.lock())
+        enDueno(c, [t](Conexion &c){ devolverACola(c, t); });
+}
+
+// Junta a los jugadores de un par en el reactor de 'a' (se ejecuta ahí). Si
+// 'b' está en otro reactor, su conexión se traspasa: la partida vive entera
+// en un solo hilo.
+static void juntarPvP(Conexion &a, const std::shared_ptr<TicketEmparejamiento> &ta,
+                      const std::shared_ptr<TicketEmparejamiento> &tb) {
+    if (a.cerrando || a.ticket != ta) {
+        devolverACola(tb);
+        return;
+    }
+    std::shared_ptr<Conexion> b = tb->conn.lock();
+    if (!b) {
+        devolverACola(a, ta);
+        return;
+    }
+    if (b->dueno.load(std::memory_order_acquire) == reactorActual) {
+        if (b->cerrando || b->ticket != tb) {
+            devolverACola(a, ta);
+            return;
+        }
+        cancelarTemporizador(ta->espera);
+        cancelarTemporizador(tb->espera);
+        iniciarPvP(a, *b);
+        return;
+    }
+    Reactor *destino = reactorActual;
+    enDueno(b, [ta, tb, destino](Conexion &b) {
+        if (b.cerrando || b.ticket != tb) {
+            devolverACola(ta);
+            return;
+        }
+        cancelarTemporizador(tb->espera);
+        migrarConexion(b, *destino, [ta, tb](Conexion &b) {
+            std::shared_ptr<Conexion> a = ta->conn.lock();
+            bool vivaA = a && !a->cerrando && a->ticket == ta && a->dueno.load() == reactorActual;
+            if (b.cerrando || b.ticket != tb) {
+                // 'b' se cerró durante el traspaso
+                if (vivaA) devolverACola(*a, ta);
+                return;
+            }
+            if (!vivaA) {
+                // 'a' se fue durante el traspaso: 'b' sigue esperando aquí
+                devolverACola(b, tb);
+                return;
+            }
+            cancelarTemporizador(ta->espera);
+            iniciarPvP(*a, b);
+        });
+    });
+}
+
+// Pasada de emparejamiento en lote (final de cada iteración del primer
+// reactor). Cada par se junta en el reactor del primer jugador.
+static void procesarEmparejamiento() {
+    if (!emparejamiento.nuevos()) return;
+    std::vector<std::shared_ptr<TicketEmparejamiento>> enEspera;
+    for (auto &par : emparejamiento.emparejar(enEspera)) {
+        std::shared_ptr<Conexion> a = par.first->conn.lock();
+        if (!a) {
+            devolverACola(par.second);
+            continue;
+        }
+        enDueno(a, [ta = par.first, tb = par.second](Conexion &a){ juntarPvP(a, ta, tb); });
+    }
+    // Solo se avisa a quien no encontró pareja en la misma iteración
+    for (auto &t : enEspera) {
+        std::shared_ptr<Conexion> c = t->conn.lock();
+        if (!c || t->estado.load() != TicketEmparejamiento::Esperando) continue;
+        if (config.emparejarPorRating)
+            sendToClient(c, "Esperando rival... (rating " + std::to_string(t->rating) + ")\n");
+        else
+            sendToClient(c, "Esperando rival...\n");
+    }
+    // Por rating, los que siguen esperando amplían su ventana con el tiempo
+    if (config.emparejarPorRating && emparejamiento.sinPareja() > 1 && revisionEmparejamiento == 0) {
+        revisionEmparejamiento = programarTemporizador(std::chrono::seconds(1), []{
+            revisionEmparejamiento = 0;
+            emparejamiento.despertar();
+        });
+    }
+}
+
+// Procesa la respuesta de un jugador en la fase actual. Ambos jugadores
+// responden a la vez: la ronda se resuelve en cuanto llega la segunda jugada,
+// y la revancha en cuanto ambos aceptan (o apenas uno la rechaza).
+static void jugadaPvP(PvPGame &g, int jugador, std::string_view msg) {
+    int propioSock = (jugador == 0 ? g.player1Sock : g.player2Sock);
+    int otroSock = (jugador == 0 ? g.player2Sock : g.player1Sock);
+    g.listo[jugador] = true;
+
+    if (g.fase == PvPGame::Fase::Movimientos) {
+        std::string_view raw = trim(msg);
+        if (igualesSinMayusculas(raw, "cancel")) {
+            sendToClient(propioSock, "Partida cancelada por el usuario.\n");
+            sendToClient(otroSock, "El otro jugador canceló la partida.\n");
+            terminarPvP(g);
+            return;
+        }
+        (jugador == 0 ? g.move1 : g.move2) = normalizeMove(raw);
+        if (!g.listo[0] || !g.listo[1]) return;
+
+        // Ambos jugadores han hecho su movimiento, determinar ganador
+        int res = decideRPS(g.move1, g.move2);
+        std::string resultado;
+        if (res == 0) resultado = "Empate! Ambos eligieron " + g.move1 + "\n";
+        else if (res == 1) resultado = "Jugador 1 gana! " + g.move1 + " vence a " + g.move2 + "\n";
+        else resultado = "Jugador 2 gana! " + g.move2 + " vence a " + g.move1 + "\n";
+        sendToClient(g.player1Sock, resultado);
+        sendToClient(g.player2Sock, resultado);
+        Conexion *c1 = buscarConexion(g.player1Sock);
+        Conexion *c2 = buscarConexion(g.player2Sock);
+        if (c1 && c2) actualizarRating(*c1, *c2, res);
+
+        // Preguntar si quieren volver a jugar
+        g.fase = PvPGame::Fase::Revancha;
+        g.listo[0] = g.listo[1] = false;
+        enviarPreguntaRevancha(g);
+        return;
+    }
+
+    if (!esRespuestaSi(msg)) {
+        sendToClient(g.player1Sock, kFinPartida);
+        sendToClient(g.player2Sock, kFinPartida);
+        terminarPvP(g);
+        return;
+    }
+    if (!g.listo[0] || !g.listo[1]) return;
+    // Si ambos quieren seguir, jugar otra ronda
+    g.fase = PvPGame::Fase::Movimientos;
+    g.listo[0] = g.listo[1] = false;
+    enviarPromptsPvP(g);
+}
+
+static void entradaPvP(Conexion &c, std::string_view msg) {
+    std::shared_ptr<PvPGame> g = c.partida;
+    if (g->listo[c.jugador]) {
+        // Ya respondió en esta fase: se guarda (con tope) para la siguiente
+        adelantarEntrada(c, g->pendiente[c.jugador], msg);
+        return;
+    }
+    PvPGame::Fase fase = g->fase;
+    jugadaPvP(*g, c.jugador, msg);
+    // Al cambiar de fase, procesar lo que ambos jugadores enviaron por adelantado
+    while (g->fase != fase) {
+        fase = g->fase;
+        for (int j = 0; j < 2 && g->fase == fase; ++j) {
+            Conexion *jugador = buscarConexion(j == 0 ? g->player1Sock : g->player2Sock);
+            if (!jugador || jugador->partida != g || g->listo[j] || g->pendiente[j].empty()) continue;
+            std::string m = std::move(g->pendiente[j].front());
+            g->pendiente[j].pop_front();
+            jugadaPvP(*g, j, m);
+        }
+    }
+}
+
+// Suma de un histograma sobre todos los hilos
+struct ResumenHistograma {
+    uint64_t cubetas[Histograma::kCubetas] = {};
+    uint64_t n = 0, suma = 0, max = 0;
+
+    void agregar(const Histograma &h) {
+        for (int i = 0; i < Histograma::kCubetas; ++i) {
+            uint64_t v = h.cubetas[i].leer();
+            cubetas[i] += v;
+            n += v;
+        }
+        suma += h.suma.leer();
+        max = std::max(max, h.max.leer());
+    }
+
+    // Cota superior de la cubeta que contiene el percentil q, en microsegundos
+    double percentil(double q) const {
+        uint64_t objetivo = (uint64_t)std::ceil(q * n), acumulado = 0;
+        for (int i = 0; i < Histograma::kCubetas; ++i) {
+            acumulado += cubetas[i];
+            if (acumulado >= objetivo) return std::min<double>(uint64_t(1) << i, max) / 1000.0;
+        }
+        return max / 1000.0;
+    }
+
+    void escribir(std::ostringstream &oss) const {
+        oss << "n=" << n;
+        if (n) oss << " prom=" << suma / n / 1000.0 << " p50=" << percentil(0.5) << " p99=" << percentil(0.99)
+                   << " p999=" << percentil(0.999) << " max=" << max / 1000.0;
+        oss << "\n";
+    }
+};
+
+// Parte del reporte que solo puede leer el reactor: los estados de juego y
+// los temporizadores son los del reactor que atiende el pedido
+struct EstadoReactor {
+    int vsMaquina = 0, esperandoRival = 0;
+    size_t temporizadores = 0;
+};
+
+static EstadoReactor leerEstadoReactor() {
+    EstadoReactor e;
+    for (auto &par : reactorActual->conexiones) {
+        EstadoConexion estado = par.second->estado;
+        if (estado == EstadoConexion::RPSMaquinaMovimiento || estado == EstadoConexion::RPSMaquinaRevancha) e.vsMaquina++;
+        if (estado == EstadoConexion::RPSEsperandoRival) e.esperandoRival++;
+    }
+    e.temporizadores = reactorActual->rueda.pendientes();
+    return e;
+}
+
+// Reporte de /stats y del puerto de administración. Se arma fuera del
+// reactor (en el ejecutor) a partir de su EstadoReactor; los contadores de
+// los hilos se leen sin lock.
+static std::string textoEstadisticas(const EstadoReactor &local) {
+    uint64_t msgEnt = 0, bytesEnt = 0, msgSal = 0, bytesSal = 0, escrituras = 0, difusiones = 0, destinatarios = 0;
+    uint64_t tomados = 0, reusados = 0, devueltos = 0, llamadas = 0, sinBuffers = 0;
+    uint64_t lentosDesconectados = 0, pausasChat = 0, chatOmitido = 0;
+    uint64_t limitadosConexion = 0, limitadosOrigen = 0, rechazadasOrigen = 0, rechazadasLleno = 0;
+    uint64_t tareas = 0, tareasRobadas = 0, tareasEnLlamador = 0;
+    uint64_t adquisiciones[(int)LockMedido::Cuenta] = {};
+    ResumenHistograma difusion, comandos[(int)Comando::Cuenta], esperas[(int)LockMedido::Cuenta];
+    size_t hilos;
+    {
+        std::lock_guard<std::mutex> lock(metricas_mutex);
+        hilos = metricasHilos.size();
+        for (const MetricasHilo &m : metricasHilos) {
+            msgEnt += m.mensajesEntrada.leer();
+            bytesEnt += m.bytesEntrada.leer();
+            msgSal += m.mensajesSalida.leer();
+            bytesSal += m.bytesSalida.leer();
+            escrituras += m.escrituras.leer();
+            llamadas += m.llamadasES.leer();
+            sinBuffers += m.sinBuffers.leer();
+            lentosDesconectados += m.lentosDesconectados.leer();
+            pausasChat += m.pausasChat.leer();
+            chatOmitido += m.chatOmitido.leer();
+            limitadosConexion += m.limitadosConexion.leer();
+            limitadosOrigen += m.limitadosOrigen.leer();
+            rechazadasOrigen += m.rechazadasOrigen.leer();
+            rechazadasLleno += m.rechazadasLleno.leer();
+            tareas += m.tareas.leer();
+            tareasRobadas += m.tareasRobadas.leer();
+            tareasEnLlamador += m.tareasEnLlamador.leer();
+            tomados += m.buffersTomados.leer();
+            reusados += m.buffersReusados.leer();
+            devueltos += m.buffersDevueltos.leer();
+            difusiones += m.difusiones.leer();
+            destinatarios += m.destinatarios.leer();
+            difusion.agregar(m.difusion);
+            for (int i = 0; i < (int)Comando::Cuenta; ++i) comandos[i].agregar(m.comandos[i]);
+            for (int i = 0; i < (int)LockMedido::Cuenta; ++i) {
+                adquisiciones[i] += m.adquisiciones[i].leer();
+                esperas[i].agregar(m.esperaLock[i]);
+            }
+        }
+    }
+
+    size_t vaciados = 0, conexiones = 0;
+    std::ostringstream porReactor;
+    for (auto &r : reactores) {
+        {
+            std::lock_guard<std::mutex> lock(r->buzon_mutex);
+            vaciados += r->porVaciar.size();
+        }
+        conexiones += r->numConexiones.load();
+        porReactor << (r->indice ? " " : "") << r->numConexiones.load();
+    }
+
+    std::ostringstream oss;
+    oss << "== Estadisticas del servidor (tiempos en us) ==\n";
+    oss << "Clientes activos: " << activeClients.load() << ", conexiones: " << conexiones
+        << ", hilos con metricas: " << hilos << "\n";
+    if (reactores.size() > 1)
+        oss << "Reactores: " << reactores.size() << " (conexiones por reactor: " << porReactor.str() << ")\n";
+    oss << "Entrada: " << msgEnt << " mensajes, " << bytesEnt << " bytes\n";
+    oss << "Salida: " << msgSal << " mensajes, " << bytesSal << " bytes en " << escrituras << " writev, "
+        << bytesEnColas.load() << " bytes en colas\n";
+    oss << "Llamadas de E/S (" << (config.ioUring ? "io_uring" : "epoll") << "): " << llamadas << ", "
+        << (msgEnt + msgSal ? (double)llamadas / (msgEnt + msgSal) : 0.0) << " por mensaje";
+    if (config.ioUring) oss << ", recepciones sin buffer " << sinBuffers;
+    oss << "\n";
+    static const char *const nombresPolitica[] = {"desconectar", "descartar", "pausar"};
+    oss << "Clientes lentos (" << nombresPolitica[(int)config.lentos] << ", marcas " << config.salidaBaja << "/"
+        << config.salidaAlta << " bytes): desconectados " << lentosDesconectados << ", pausas de chat "
+        << pausasChat << ", mensajes de chat omitidos " << chatOmitido << "\n";
+    oss << "Limites de tasa: mensajes descartados " << limitadosConexion + limitadosOrigen << " (por conexion "
+        << limitadosConexion << ", por direccion " << limitadosOrigen << "), conexiones rechazadas "
+        << rechazadasOrigen + rechazadasLleno << " (por direccion " << rechazadasOrigen << ", servidor lleno "
+        << rechazadasLleno << "), direcciones seguidas " << origenes.tamanno() << "\n";
+    oss << "Ejecutor: " << ejecutor.hilos() << " trabajadores, tareas " << tareas << " (robadas " << tareasRobadas
+        << ", en el llamador por cola llena " << tareasEnLlamador << "), en cola " << ejecutor.enCola() << "\n";
+    oss << "Buffers de entrada: " << tomados - devueltos << " en uso, " << tomados << " tomados ("
+        << reusados << " reusados del pool)\n";
+    oss << "Difusiones: " << difusiones << ", destinatarios promedio "
+        << (difusiones ? (double)destinatarios / difusiones : 0.0) << ", fan-out ";
+    difusion.escribir(oss);
+    size_t numSalas, conTrivia = 0;
+    {
+        std::lock_guard<std::mutex> lock(salas_mutex);
+        numSalas = salas.size();
+        for (auto &par : salas) conTrivia += par.second->triviaActual() ? 1 : 0;
+    }
+    oss << "Salas: " << numSalas << "\n";
+    oss << "Juegos: trivia en " << conTrivia << " salas, PvP " << partidasPvP.load()
+        << ", vs maquina " << local.vsMaquina << ", esperando rival " << local.esperandoRival << "\n";
+    oss << "Colas: temporizadores " << local.temporizadores << ", vaciados pendientes " << vaciados
+        << ", emparejamiento sin pareja " << emparejamiento.sinPareja() << "\n";
+    oss << "Espera de locks (solo adquisiciones con espera):\n";
+    for (int i = 0; i < (int)LockMedido::Cuenta; ++i) {
+        oss << "  " << nombresLock[i] << ": " << adquisiciones[i] << " adquisiciones, espera ";
+        esperas[i].escribir(oss);
+    }
+    oss << "Latencia por comando:\n";
+    for (int i = 0; i < (int)Comando::Cuenta; ++i) {
+        if (!comandos[i].n) continue;
+        oss << "  " << nombresComando[i] << ": ";
+        comandos[i].escribir(oss);
+    }
+    return oss.str();
+}
+
+// Puerto de administración: cada conexión recibe el reporte y se cierra. El
+// reactor solo acepta y toma su parte del estado; el resto va al ejecutor.
+static void atenderAdmin(int sockAdmin) {
+    int sock;
+    struct sockaddr_in conf;
+    while (aceptarConexion(sock, sockAdmin, conf)) {
+        diferir([sock, local = leerEstadoReactor()]{
+            std::string reporte = textoEstadisticas(local);
+            send(sock, reporte.data(), reporte.size(), MSG_NOSIGNAL);
+            close(sock);
+        });
+    }
+}
+
+// Mensajes del historial que se reenvían al entrar a una sala, y cuántos
+// bytes puede ocupar como máximo un reenvío en la cola de salida
+static constexpr size_t kHistorialAlEntrar = 20;
+static constexpr size_t kBytesHistorial = MAX_SALIDA_BYTES / 4;
+static const Mensaje kFinHistorial = hacerMensaje("-- fin del historial --\n");
+
+// Reenvía al cliente los últimos n mensajes de su sala en un solo lote. Si
+// superan kBytesHistorial (o la marca baja de la cola) se omiten los más viejos.
+static void enviarHistorial(Conexion &c, size_t n, bool avisarSiVacio) {
+    std::vector<Mensaje> lote = c.sala->historial.ultimos(n);
+    size_t bytes = 0, desde = lote.size(), tope = std::min(kBytesHistorial, config.salidaBaja);
+    while (desde > 0 && bytes + lote[desde - 1]->size() <= tope) bytes += lote[--desde]->size();
+    lote.erase(lote.begin(), lote.begin() + desde);
+    if (lote.empty()) {
+        if (avisarSiVacio) sendToClient(c.sock, "No hay mensajes en el historial de la sala\n");
+        return;
+    }
+    lote.insert(lote.begin(), hacerMensaje("-- últimos " + std::to_string(lote.size()) + " mensajes de " +
+                                           c.sala->nombre + " --\n"));
+    lote.push_back(kFinHistorial);
+    sendToClient(c.shared_from_this(), lote, TipoMensaje::Chat);
+}
+
+// Nombres de usuario: una palabra (es la clave de /msg), hasta 32 bytes
+static bool nombreDeUsuarioValido(std::string_view nombre) {
+    if (nombre.empty() || nombre.size() > 32) return false;
+    return std::none_of(nombre.begin(), nombre.end(), [](char ch){ return std::isspace((unsigned char)ch); });
+}
+
+// Primer mensaje: nombre del cliente
+static void registrarCliente(Conexion &c, std::string_view msg) {
+    std::string_view elegido = trim(msg);
+    if (!nombreDeUsuarioValido(elegido)) {
+        sendToClient(c.sock, "Nombre inválido (una palabra, hasta 32 caracteres). Elige otro:\n");
+        return;
+    }
+    std::string nombre(elegido);
+    c.nombre = nombre;
+
+    // Registrar cliente (en menu por defecto); el nombre debe estar libre
+    c.inMenu = true;
+    if (!registrarEnIndice(c.shared_from_this())) {
+        sendToClient(c.sock, "El nombre " + nombre + " ya está en uso. Elige otro:\n");
+        return;
+    }
+    c.registrado = true;
+    c.estado = EstadoConexion::Menu;
+    entrarASala(c, kNombreLobby);
+
+    // Enviar bienvenida local y notificar a la sala
+    sendToClient(c.sock, "Bienvenido " + nombre + "\n");
+    broadcastMessage(*lobby, "Usuario " + nombre + " se ha conectado\n", c.sock, TipoMensaje::Chat);
+    // Enviar menú inicial al cliente y lo último que se habló en el lobby
+    sendMenuToClient(c.sock);
+    enviarHistorial(c, kHistorialAlEntrar, false);
+}
+
+// Límites de tasa para lo que se difunde o reenvía a otros (chat de sala y
+// /msg): el cupo de la conexión y, si hay límite por dirección, el de su
+// origen. Lo que se pasa se descarta sin difundir y se avisa una vez por
+// racha. Los comandos y las jugadas no pasan por aquí: solo le responden a
+// quien los manda.
+static bool admitirMensaje(Conexion &c) {
+    bool porConexion = config.tasaMensajes > 0 && !c.cupoMensajes.tomar(config.tasaMensajes, c.ultimaActividad);
+    bool porOrigen = false;
+    if (!porConexion && c.origen && config.tasaMensajesIp > 0) {
+        auto lock = bloquear(c.origen->mutex, LockMedido::Origenes);
+        porOrigen = !c.origen->mensajes.tomar(config.tasaMensajesIp, c.ultimaActividad);
+    }
+    if (!porConexion && !porOrigen) {
+        c.limitada = false;
+        return true;
+    }
+    (porConexion ? metricas().limitadosConexion : metricas().limitadosOrigen).sumar();
+    if (!c.limitada) {
+        c.limitada = true;
+        static const Mensaje aviso = hacerMensaje("Demasiados mensajes: se descartan hasta que bajes el ritmo\n");
+        sendToClient(c.sock, aviso);
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Comandos del menú. Cada mensaje se separa en el lugar (string_view) en
+// palabra de comando y argumentos; la palabra se busca en una tabla hash
+// perfecta construida en compilación. Para agregar un comando basta con
+// sumar una fila a kComandos.
+// ---------------------------------------------------------------------------
+
+static void cmdTrama(Conexion &c, std::string_view args) {
+    // Cambio de delimitación para los mensajes siguientes
+    if (args == "longitud") {
+        c.trama = ModoTrama::Longitud;
+        sendToClient(c.sock, "Trama: prefijo de 4 bytes (big-endian) con el largo del mensaje\n");
+    } else if (args == "lineas") {
+        c.trama = ModoTrama::Lineas;
+        sendToClient(c.sock, "Trama: un mensaje por línea\n");
+    } else {
+        sendToClient(c.sock, "Uso: /trama lineas | /trama longitud\n");
+    }
+}
+
+// Sonda de latencia: responde de inmediato con el mismo token
+static void cmdPing(Conexion &c, std::string_view args) {
+    std::string pong;
+    pong.reserve(args.size() + 6);
+    pong.append("PONG");
+    if (!args.empty()) pong.append(" ").append(args);
+    pong.append("\n");
+    sendToClient(c.sock, pong);
+}
+
+static void cmdStats(Conexion &c, std::string_view) {
+    diferir([c = c.shared_from_this(), local = leerEstadoReactor()]{
+        sendToClient(c, textoEstadisticas(local));
+    });
+}
+
+// /juego_trivia [categoria] [facil|media|dificil]
+static void cmdTrivia(Conexion &c, std::string_view args) {
+    if (c.sala->triviaActual()) {
+        sendToClient(c.sock, "Ya hay una trivia en curso\n");
+        return;
+    }
+    int categoria = -1, dificultad = -1;
+    while (!args.empty()) {
+        size_t espacio = args.find(' ');
+        std::string_view filtro = args.substr(0, espacio);
+        args = (espacio == std::string_view::npos ? std::string_view() : trim(args.substr(espacio + 1)));
+        if (dificultad < 0 && (dificultad = dificultadDesdeTexto(filtro)) >= 0) continue;
+        if (categoria < 0 && (categoria = bancoTrivia.buscarCategoria(filtro)) >= 0) continue;
+        std::string lista = "Filtro desconocido. Categorías:";
+        for (uint32_t i = 0; i < bancoTrivia.numCategorias(); ++i) lista.append(" ").append(bancoTrivia.categoria(i));
+        lista += ". Dificultad: facil, media o dificil.\n";
+        sendToClient(c.sock, lista);
+        return;
+    }
+    // El sorteo son unas pocas lecturas del índice: se hace aquí mismo
+    thread_local std::mt19937 gen(std::random_device{}());
+    auto preguntas = bancoTrivia.muestrear(config.preguntasTrivia, categoria, dificultad, gen);
+    if (preguntas.empty()) sendToClient(c.sock, "No hay preguntas con ese filtro\n");
+    else if (!iniciarTrivia(c.sala, std::move(preguntas))) sendToClient(c.sock, "Ya hay una trivia en curso\n");
+}
+
+static void cmdRPS(Conexion &c, std::string_view) {
+    setClientMenuState(c.id, false); // Mark as out of menu to process game input
+    sendToClient(c.sock, "Elige modo: 1) vs Maquina 2) vs Jugador\n");
+    c.estado = EstadoConexion::EligiendoModoRPS;
+}
+
+// /msg <usuario> <texto>: entrega directa buscando al destinatario por nombre
+// en el registro; cuesta un lookup y un encolado sin importar cuántos haya.
+static void cmdMsg(Conexion &c, std::string_view args) {
+    size_t espacio = args.find(' ');
+    std::string_view destino = args.substr(0, espacio);
+    std::string_view texto = (espacio == std::string_view::npos ? std::string_view() : trim(args.substr(espacio + 1)));
+    if (destino.empty() || texto.empty()) {
+        sendToClient(c.sock, "Uso: /msg <usuario> <texto>\n");
+        return;
+    }
+    auto reg = leerRegistro();
+    auto it = reg->porNombre.find(std::string(destino));
+    if (it == reg->porNombre.end() || it->second->cerrando) {
+        sendToClient(c.sock, "Usuario " + std::string(destino) + " no está conectado\n");
+        return;
+    }
+    if (it->second.get() == &c) {
+        sendToClient(c.sock, "No puedes enviarte mensajes a ti mismo\n");
+        return;
+    }
+    if (!admitirMensaje(c)) return;
+    std::string privado;
+    privado.reserve(c.nombre.size() + texto.size() + 13);
+    privado.append(c.nombre).append(" (privado): ").append(texto).append("\n");
+    sendToClient(it->second, hacerMensaje(std::move(privado)), TipoMensaje::Chat);
+}
+
+// Nombres de sala: letras, números, '_' o '-', sin distinguir mayúsculas
+static bool nombreDeSala(std::string_view texto, std::string &nombre) {
+    if (texto.empty() || texto.size() > 32) return false;
+    nombre.clear();
+    for (char ch : texto) {
+        unsigned char u = (unsigned char)ch;
+        if (!std::isalnum(u) && ch != '_' && ch != '-') return false;
+        nombre.push_back((char)std::tolower(u));
+    }
+    return true;
+}
+
+// /history [N]
+static void cmdHistorial(Conexion &c, std::string_view args) {
+    size_t n = kHistorialAlEntrar;
+    if (!args.empty()) {
+        auto r = std::from_chars(args.data(), args.data() + args.size(), n);
+        if (r.ec != std::errc() || r.ptr != args.data() + args.size() || n == 0) {
+            sendToClient(c.sock, "Uso: /history [N] (hasta " + std::to_string(HistorialSala::kCapacidad) + ")\n");
+            return;
+        }
+    }
+    enviarHistorial(c, n, true);
+}
+
+// Mueve al cliente a otra sala avisando en ambas. Queda en el menú salvo que
+// la sala nueva tenga una trivia en curso, a la que se suma como jugador.
+static void cambiarDeSala(Conexion &c, const std::string &nombre) {
+    std::shared_ptr<Sala> anterior = c.sala;
+    std::shared_ptr<Sala> sala = entrarASala(c, nombre);
+    broadcastMessage(*anterior, "Usuario " + c.nombre + " salió de la sala\n", -1, TipoMensaje::Chat);
+    broadcastMessage(*sala, "Usuario " + c.nombre + " entró a la sala\n", c.sock, TipoMensaje::Chat);
+    c.inMenu = !sala->triviaActual();
+    sendToClient(c.sock, "Estás en la sala " + sala->nombre + " (" +
+                         std::to_string(sala->leerMiembros()->size()) + " miembros)\n");
+    enviarHistorial(c, kHistorialAlEntrar, false);
+}
+
+// /unirse <sala>
+static void cmdUnirse(Conexion &c, std::string_view args) {
+    std::string nombre;
+    if (!nombreDeSala(args, nombre)) {
+        sendToClient(c.sock, "Uso: /unirse <sala> (letras, números, '_' o '-', hasta 32)\n");
+        return;
+    }
+    if (nombre == c.sala->nombre) {
+        sendToClient(c.sock, "Ya estás en la sala " + nombre + "\n");
+        return;
+    }
+    cambiarDeSala(c, nombre);
+}
+
+// Vuelve al lobby
+static void cmdSalir(Conexion &c, std::string_view) {
+    if (c.sala == lobby) {
+        sendToClient(c.sock, std::string("Ya estás en ") + kNombreLobby + "\n");
+        return;
+    }
+    cambiarDeSala(c, kNombreLobby);
+}
+
+static void cmdSalas(Conexion &c, std::string_view) {
+    std::vector<std::shared_ptr<Sala>> lista;
+    {
+        auto lock = bloquear(salas_mutex, LockMedido::Salas);
+        lista.reserve(salas.size());
+        for (auto &par : salas) lista.push_back(par.second);
+    }
+    std::sort(lista.begin(), lista.end(), [](const std::shared_ptr<Sala> &a, const std::shared_ptr<Sala> &b) {
+        return a->nombre < b->nombre;
+    });
+    std::string texto = "Salas:\n";
+    for (auto &sala : lista) {
+        texto.append("  ").append(sala->nombre).append(" (").append(std::to_string(sala->leerMiembros()->size()))
+             .append(sala->triviaActual() ? " miembros, trivia en curso)" : " miembros)");
+        if (sala == c.sala) texto.append(" <- estás aquí");
+        texto.append("\n");
+    }
+    sendToClient(c.sock, texto);
+}
+
+// Comando para desconectarse
+static void cmdBye(Conexion &c, std::string_view) {
+    sendToClient(c.sock, "Adios " + c.nombre + "\n");
+    marcarCierre(c);
+}
+
+struct ComandoMenu {
+    std::string_view nombre;
+    void (*manejar)(Conexion &, std::string_view args);
+    Comando metrica;
+    bool conArgumentos;   // si no, el mensaje debe ser exactamente el nombre
+    bool antesDeTrivia;   // se atiende aunque haya una pregunta de trivia abierta
+};
+
+static constexpr ComandoMenu kComandos[] = {
+    {"/trama",               cmdTrama,  Comando::Trama,         true,  true},
+    {"/ping",                cmdPing,   Comando::Ping,          true,  true},
+    {"/stats",               cmdStats,  Comando::Stats,         false, true},
+    {"/juego_trivia",        cmdTrivia, Comando::IniciarTrivia, true,  true},
+    {"/piedra_papel_tijera", cmdRPS,    Comando::IniciarRPS,    false, true},
+    {"/msg",                 cmdMsg,    Comando::Privado,       true,  true},
+    {"/unirse",              cmdUnirse, Comando::Salas,         true,  true},
+    {"/salir",               cmdSalir,  Comando::Salas,         false, true},
+    {"/salas",               cmdSalas,  Comando::Salas,         false, true},
+    {"/history",             cmdHistorial, Comando::Historial,  true,  true},
+    // Con una pregunta abierta, "BYE" cuenta como respuesta (comportamiento original)
+    {"BYE",                  cmdBye,    Comando::Bye,           false, false},
+};
+static constexpr size_t kNumComandos = sizeof(kComandos) / sizeof(kComandos[0]);
+
+// FNV-1a de 32 bits
+static constexpr uint32_t hashComando(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (char ch : s) h = (h ^ (unsigned char)ch) * 16777619u;
+    return h;
+}
+
+// Tabla de ranuras -> índice en kComandos. Si dos comandos caen en la misma
+// ranura la evaluación constexpr falla y el programa no compila.
+static constexpr size_t kRanurasComandos = 53;
+struct TablaComandos { int8_t ranura[kRanurasComandos]; };
+
+static constexpr TablaComandos construirTablaComandos() {
+    TablaComandos t{};
+    for (auto &r : t.ranura) r = -1;
+    for (size_t i = 0; i < kNumComandos; ++i) {
+        size_t r = hashComando(kComandos[i].nombre) % kRanurasComandos;
+        if (t.ranura[r] != -1) throw "colisión en la tabla de comandos: cambiar kRanurasComandos";
+        t.ranura[r] = (int8_t)i;
+    }
+    return t;
+}
+static constexpr TablaComandos kTablaComandos = construirTablaComandos();
+static_assert(kNumComandos <= kRanurasComandos, "más comandos que ranuras");
+
+static const ComandoMenu *buscarComando(std::string_view palabra) {
+    int i = kTablaComandos.ranura[hashComando(palabra) % kRanurasComandos];
+    return (i >= 0 && kComandos[i].nombre == palabra) ? &kComandos[i] : nullptr;
+}
+
+// Bucle principal del cliente (comandos, chat y respuestas de trivia)
+static void mensajeMenu(Conexion &c, std::string_view raw) {
+    // Trim leading/trailing whitespace
+    std::string_view msg = trim(raw);
+
+    if (msg.empty()) return;
+
+    // Separar "palabra argumentos" sin copiar
+    size_t espacio = msg.find(' ');
+    std::string_view palabra = msg.substr(0, espacio);
+    std::string_view args = (espacio == std::string_view::npos ? std::string_view() : trim(msg.substr(espacio + 1)));
+    const ComandoMenu *cmd = buscarComando(palabra);
+    if (cmd && !cmd->conArgumentos && !args.empty()) cmd = nullptr;
+
+    std::shared_ptr<SesionTrivia> trivia = c.sala->triviaActual();
+    bool preguntaAbierta = trivia && trivia->preguntaAbierta();
+    if (cmd && (cmd->antesDeTrivia || !preguntaAbierta)) {
+        comandoActual = cmd->metrica;
+        cmd->manejar(c, args);
+        return;
+    }
+
+    // Si hay una pregunta activa para la trivia, chequear respuestas
+    if (preguntaAbierta) {
+        comandoActual = Comando::RespuestaTrivia;
+        responderTrivia(trivia, c.id, msg, c.ultimaActividad);
+        // Si la trivia está activa, también no hacemos broadcast normal
+        return;
+    }
+
+    // En el lobby, desde el menu principal, no hay chat abierto: se chatea en
+    // una sala o con /msg
+    if (c.sala == lobby && c.inMenu.load()) {
+        static const Mensaje info = hacerMensaje("En el menu principal. Comandos disponibles:\n"
+                                        "/juego_trivia\n"
+                                        "/piedra_papel_tijera\n"
+                                        "/unirse <sala> para chatear en una sala\n"
+                                        "/msg <usuario> <texto> para un mensaje privado\n"
+                                        "Escribe comando para jugar.\n");
+        sendToClient(c.sock, info);
+        return;
+    }
+
+    // Mensaje normal: reenviar a la sala
+    if (!admitirMensaje(c)) return;
+    std::string paraSala;
+    paraSala.reserve(c.nombre.size() + msg.size() + 3);
+    paraSala.append(c.nombre).append(": ").append(msg).append("\n");
+    Mensaje m = hacerMensaje(std::move(paraSala));
+    broadcastMessage(*c.sala, m, c.sock, TipoMensaje::Chat);
+    c.sala->historial.agregar(m);
+}
+
+static Comando comandoPorEstado(EstadoConexion e) {
+    switch (e) {
+    case EstadoConexion::EsperandoNombre: return Comando::Registro;
+    case EstadoConexion::Menu: return Comando::Chat;
+    case EstadoConexion::EligiendoModoRPS: return Comando::IniciarRPS;
+    default: return Comando::JugadaRPS;
+    }
+}
+
+static void despacharMensaje(Conexion &c, std::string_view msg);
+
+// Despacha un mensaje según el estado de la conexión y mide cuánto tardó
+void procesarMensaje(Conexion &c, std::string_view msg) {
+    if (c.cerrando) return;
+    auto inicio = Reloj::now();
+    Comando previo = comandoActual; // procesarMensaje se reentra al reprocesar pendientes
+    comandoActual = comandoPorEstado(c.estado);
+    despacharMensaje(c, msg);
+    metricas().comandos[(int)comandoActual].registrar(inicio);
+    comandoActual = previo;
+}
+
+static void despacharMensaje(Conexion &c, std::string_view msg) {
+    switch (c.estado) {
+    case EstadoConexion::EsperandoNombre:
+        registrarCliente(c, msg);
+        break;
+    case EstadoConexion::Menu:
+        mensajeMenu(c, msg);
+        break;
+    case EstadoConexion::EligiendoModoRPS: {
+        std::string_view choice = trim(msg);
+        if (choice == "1") {
+            playRPSvsMachine(c);
+        } else if (choice == "2") {
+            playRPSvsPlayer(c);
+        } else {
+            sendToClient(c.sock, "Opción inválida. Volviendo al menú.\n");
+            volverAlMenu(c); // Restore menu state
+        }
+        break;
+    }
+    case EstadoConexion::RPSMaquinaMovimiento:
+        rpsMaquinaMovimiento(c, msg);
+        break;
+    case EstadoConexion::RPSMaquinaRevancha:
+        rpsMaquinaRevancha(c, msg);
+        break;
+    case EstadoConexion::RPSEsperandoRival:
+        // El jugador sigue esperando: su entrada se usará como primer movimiento
+        adelantarEntrada(c, c.ticket->pendiente, msg);
+        break;
+    case EstadoConexion::RPSJugador:
+        entradaPvP(c, msg);
+        break;
+    }
+}
+
+// Marca la conexión para cierre. La partida en curso se resuelve de inmediato;
+// el descriptor se cierra al final de la iteración del reactor.
+void marcarCierre(Conexion &c) {
+    if (c.cerrando) return;
+    c.cerrando = true;
+    reactorActual->porCerrar.push_back(c.sock);
+
+    if (c.ticket) {
+        // Sale de la cola; la entrada muerta se descarta en la próxima pasada
+        ColaEmparejamiento::cancelar(*c.ticket);
+        cancelarTemporizador(c.ticket->espera);
+        c.ticket.reset();
+    }
+    if (c.partida) {
+        std::shared_ptr<PvPGame> g = c.partida;
+        c.partida.reset();
+        // cliente desconectó en medio de una partida PvP
+        int otroSock = (c.jugador == 0 ? g->player2Sock : g->player1Sock);
+        sendToClient(otroSock, c.jugador == 0 ? "El jugador 1 se ha desconectado. Fin del juego.\n"
+                                              : "El jugador 2 se ha desconectado. Fin del juego.\n");
+        terminarPvP(*g);
+    }
+}
+
+// Limpieza al desconectar
+static void cerrarPendientes() {
+    Reactor &r = *reactorActual;
+    for (int sock : r.porCerrar) {
+        Conexion *c = buscarConexion(sock);
+        if (!c) continue;
+        int clientId = c->id;
+        if (c->registrado) {
+            quitarDelIndice(*c);
+            quitarDeSala(*c);
+        }
+        cancelarTemporizador(c->inactividad);
+        cancelarTemporizador(c->nombreSinFin);
+        if (c->traspasoA) {
+            // Se cerró esperando un traspaso: el destino se entera igual
+            Reactor *destino = std::exchange(c->traspasoA, nullptr);
+            destino->publicar([propia = c->shared_from_this(), alLlegar = std::move(c->alTraspasar)]{
+                alLlegar(*propia);
+            });
+        }
+        // Último intento de entregar lo pendiente (p. ej. la despedida)
+        vaciarSalida(*c);
+        {
+            auto lock = bloquear(c->salida_mutex, LockMedido::Salida);
+            c->cerrada = true;
+            c->salida.clear();
+            bytesEnColas -= c->bytesSalida;
+            c->bytesSalida = 0;
+            c->bytesChat = 0;
+            c->bytesRechazados = 0;
+        }
+        if (r.anillo) {
+            // La recepción multishot retiene el socket hasta cancelarse; el
+            // envío final se entrega antes del close, que libera el descriptor
+            if (c->recepcion) r.anillo->cancelar(c->recepcion);
+            r.anillo->enviarPendientes();
+        }
+        close(sock); // también lo retira del epoll
+        r.conexiones.erase(sock);
+        r.numConexiones--;
+
+        activeClients--;
+        std::cout << "Cliente " << clientId << " desconectado" << std::endl;
+    }
+    r.porCerrar.clear();
+}
+
+// Extrae el siguiente mensaje completo del buffer de entrada según el modo de trama.
+// Devuelve 1 si hay mensaje, 0 si faltan datos y -1 si el mensaje excede MAX_MENSAJE.
+static int extraerMensaje(Conexion &c, std::string_view &msg) {
+    std::string_view datos = c.entrada.pendiente();
+    if (c.trama == ModoTrama::Lineas) {
+        const void *nl = std::memchr(datos.data(), '\n', datos.size());
+        if (!nl) return datos.size() > MAX_MENSAJE ? -1 : 0;
+        size_t largo = static_cast<const char *>(nl) - datos.data();
+        msg = datos.substr(0, largo);
+        if (!msg.empty() && msg.back() == '\r') msg.remove_suffix(1);
+        c.entrada.consumir(largo + 1);
+        return 1;
+    }
+
+    if (datos.size() < 4) return 0;
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(datos.data());
+    uint32_t largo = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    if (largo > MAX_MENSAJE) return -1;
+    if (datos.size() < 4 + (size_t)largo) return 0;
+    msg = datos.substr(4, largo);
+    c.entrada.consumir(4 + largo);
+    return 1;
+}
+
+// Procesa todos los mensajes completos que haya en el buffer de entrada
+static void procesarEntrada(Conexion &c) {
+    while (!c.cerrando) {
+        std::string_view msg;
+        int r = extraerMensaje(c, msg);
+        if (r == 0) return;
+        if (r < 0) {
+            sendToClient(c.sock, "Mensaje demasiado largo, se cierra la conexión\n");
+            marcarCierre(c);
+            return;
+        }
+        metricas().mensajesEntrada.sumar();
+        procesarMensaje(c, msg);
+    }
+}
+
+// Compatibilidad: clientes antiguos envían el nombre sin '\n' y esperan
+// respuesta. Un corte de lectura no basta para darlo por completo (el nombre
+// puede llegar partido en dos segmentos): se toma solo si el cliente no envía
+// nada más durante kEsperaNombreSinFin.
+static constexpr std::chrono::milliseconds kEsperaNombreSinFin{200};
+
+static void programarNombreSinFin(Conexion &c) {
+    cancelarTemporizador(c.nombreSinFin);
+    std::weak_ptr<Conexion> w = c.shared_from_this();
+    c.nombreSinFin = programarTemporizador(kEsperaNombreSinFin, [w]{
+        std::shared_ptr<Conexion> c = w.lock();
+        if (!c || c->cerrando) return;
+        c->nombreSinFin = 0;
+        if (c->estado != EstadoConexion::EsperandoNombre || c->trama != ModoTrama::Lineas) return;
+        std::string_view nombre = c->entrada.pendiente();
+        if (nombre.empty()) return;
+        c->entrada.consumir(nombre.size());
+        procesarMensaje(*c, nombre);
+        c->entrada.soltarSiVacio();
+    });
+}
+
+// No hay más datos por ahora: suelta el buffer si quedó vacío
+static void finDeLectura(Conexion &c) {
+    c.entrada.soltarSiVacio();
+    if (c.estado == EstadoConexion::EsperandoNombre && c.trama == ModoTrama::Lineas
+        && !c.entrada.pendiente().empty())
+        programarNombreSinFin(c);
+}
+
+// Lee todo lo disponible (epoll edge-triggered) directo al buffer de entrada de
+// la conexión; cada lectura puede traer varios mensajes o solo parte de uno.
+static void manejarCliente(Conexion *c) {
+    while (!c->cerrando) {
+        size_t libre;
+        char *destino = c->entrada.espacio(BUFFERSIZE, libre);
+        ssize_t n = read(c->sock, destino, libre);
+        metricas().llamadasES.sumar();
+        if (n > 0) {
+            c->ultimaActividad = Reloj::now();
+            metricas().bytesEntrada.sumar(n);
+            c->entrada.escrito(n);
+            procesarEntrada(*c);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            finDeLectura(*c);
+            return;
+        }
+        marcarCierre(*c); // n == 0 (cierre) o error
+    }
+}
+
+// Desconexión por inactividad. El temporizador no se reprograma con cada
+// mensaje: al vencer compara con la última actividad y, si hubo, se
+// reprograma por el tiempo que falta.
+static void programarInactividad(const std::shared_ptr<Conexion> &c, std::chrono::milliseconds en) {
+    std::weak_ptr<Conexion> w = c;
+    c->inactividad = programarTemporizador(en, [w]{
+        std::shared_ptr<Conexion> c = w.lock();
+        if (!c || c->cerrando) return;
+        auto limite = std::chrono::milliseconds(config.inactividadSeg * 1000LL);
+        auto inactivo = std::chrono::duration_cast<std::chrono::milliseconds>(Reloj::now() - c->ultimaActividad);
+        if (inactivo < limite) {
+            programarInactividad(c, limite - inactivo);
+            return;
+        }
+        sendToClient(c, "Desconectado por inactividad\n");
+        marcarCierre(*c);
+    });
+}
+
+// io_uring: arma la recepción multishot de la conexión. La operación la
+// mantiene viva hasta su último completado.
+static void armarRecepcion(Conexion &c) {
+    if (!c.recepcion) {
+        c.recepcion = new OperacionIO(OperacionIO::Recibir);
+        c.recepcion->conn = c.shared_from_this();
+    }
+    reactorActual->anillo->recibirMultishot(c.sock, c.recepcion);
+}
+
+// Agrega la conexión a la tabla del reactor actual y la registra en su epoll
+// (o arma su recepción en el anillo). Devuelve false si el registro falló: la
+// conexión queda en la tabla para cerrarse por el camino normal.
+static bool adoptarConexion(const std::shared_ptr<Conexion> &c) {
+    Reactor &r = *reactorActual;
+    r.conexiones[c->sock] = c;
+    r.numConexiones++;
+    if (config.inactividadSeg > 0) {
+        auto limite = std::chrono::milliseconds(config.inactividadSeg * 1000LL);
+        auto inactivo = std::chrono::duration_cast<std::chrono::milliseconds>(Reloj::now() - c->ultimaActividad);
+        programarInactividad(c, std::max(limite - inactivo, std::chrono::milliseconds(1)));
+    }
+    if (r.anillo) {
+        armarRecepcion(*c);
+        return true;
+    }
+    // EPOLLOUT se registra desde el inicio: en modo edge-triggered solo avisa
+    // cuando el socket vuelve a tener espacio tras un EAGAIN.
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = c.get();
+    if (epoll_ctl(r.epfd, EPOLL_CTL_ADD, c->sock, &ev) < 0) {
+        std::cerr << "Error epoll_ctl: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Traspasa la conexión del reactor actual (su dueño) a 'destino', que al
+// recibirla ejecuta 'alLlegar' (también si se cerró antes de llegar). Solo al
+// final de la iteración: la conexión no puede estar en el lote de eventos en
+// curso. Los temporizadores propios de la conexión se cancelan aquí y se
+// vuelven a programar en el destino.
+static void migrarConexion(Conexion &c, Reactor &destino, std::function<void(Conexion &)> alLlegar) {
+    Reactor &r = *reactorActual;
+    bool enviando;
+    {
+        auto lock = bloquear(c.salida_mutex, LockMedido::Salida);
+        enviando = c.enVuelo > 0;
+    }
+    if (r.anillo && (c.recepcion || enviando)) {
+        // Primero terminan las operaciones en vuelo en este anillo: con una
+        // recepción en cada anillo los datos podrían llegar desordenados
+        c.traspasoA = &destino;
+        c.alTraspasar = std::move(alLlegar);
+        if (c.recepcion) r.anillo->cancelar(c.recepcion);
+        return;
+    }
+    std::shared_ptr<Conexion> propia = c.shared_from_this();
+    cancelarTemporizador(c.inactividad);
+    c.inactividad = 0;
+    if (!r.anillo) epoll_ctl(r.epfd, EPOLL_CTL_DEL, c.sock, nullptr);
+    r.conexiones.erase(c.sock);
+    r.numConexiones--;
+    {
+        // El dueño cambia junto con la tarea de llegada: todo lo que se le
+        // publique al destino después de leer el dueño nuevo corre tras ella
+        auto lock = bloquear(destino.buzon_mutex, LockMedido::Vaciado);
+        c.dueno.store(&destino, std::memory_order_release);
+        destino.tareas.push_back([propia, alLlegar = std::move(alLlegar)]{
+            if (!adoptarConexion(propia)) marcarCierre(*propia);
+            reactorActual->vaciarEnTick.push_back(propia);
+            alLlegar(*propia);
+            // Lo que llegó al socket durante el traspaso (con io_uring lo trae la recepción)
+            if (!reactorActual->anillo) manejarCliente(propia.get());
+        });
+    }
+    destino.despertar();
+}
+
+// io_uring: completa un traspaso diferido cuando ya no hay operaciones en vuelo
+static void retomarTraspaso(Conexion &c) {
+    if (!c.traspasoA || c.recepcion) return;
+    {
+        auto lock = bloquear(c.salida_mutex, LockMedido::Salida);
+        if (c.enVuelo) return;
+    }
+    Reactor *destino = std::exchange(c.traspasoA, nullptr);
+    migrarConexion(c, *destino, std::move(c.alTraspasar));
+}
+
+// Id del último cliente aceptado (compartido por todos los reactores)
+static std::atomic<int> ultimoClienteId{0};
+
+// Filtro de admisión, justo después del accept y antes de cualquier alta:
+// cupo de conexiones de la dirección y máximo de clientes. Un rechazo cuesta
+// el close (y el aviso de servidor lleno), sin reservar nada por cliente.
+// Devuelve los clientes activos contando a este, o 0 si se rechazó.
+static int admitirConexion(int sockCliente, const struct sockaddr_in *dir, int nClientes,
+                            std::shared_ptr<OrigenCliente> &origen) {
+    if (config.tasaMensajesIp > 0 || config.tasaConexionesIp > 0) {
+        struct sockaddr_in propia;
+        socklen_t largo = sizeof(propia);
+        // io_uring acepta sin dirección: se pide solo si hay límites por dirección
+        if (!dir && getpeername(sockCliente, (struct sockaddr *)&propia, &largo) == 0) dir = &propia;
+        if (dir) {
+            auto ahora = Reloj::now();
+            origen = origenes.buscar(dir->sin_addr.s_addr, ahora);
+            if (config.tasaConexionesIp > 0) {
+                auto lock = bloquear(origen->mutex, LockMedido::Origenes);
+                if (!origen->conexiones.tomar(config.tasaConexionesIp, ahora)) {
+                    lock.unlock();
+                    origen.reset();
+                    metricas().rechazadasOrigen.sumar();
+                    close(sockCliente);
+                    return 0;
+                }
+            }
+        }
+    }
+    // Si ya alcanzamos el máximo de clientes concurrentes, rechazamos
+    int activos = activeClients.fetch_add(1) + 1;
+    if (activos > nClientes) {
+        activeClients--;
+        origen.reset();
+        metricas().rechazadasLleno.sumar();
+        static const char lleno[] = "Servidor lleno, intente más tarde\n";
+        send(sockCliente, lleno, sizeof(lleno) - 1, MSG_NOSIGNAL);
+        close(sockCliente);
+        std::cout << "Rechazada conexión: servidor lleno" << std::endl;
+        return 0;
+    }
+    return activos;
+}
+
+// Da de alta una conexión recién aceptada en el reactor. 'dir' es la
+// dirección del cliente si el accept la trajo.
+static void nuevaConexion(Reactor &r, int sockCliente, const struct sockaddr_in *dir, int nClientes) {
+    std::shared_ptr<OrigenCliente> origen;
+    int activos = admitirConexion(sockCliente, dir, nClientes, origen);
+    if (!activos) return;
+
+    // Aceptada
+    int clienteId = ++ultimoClienteId;
+    std::cout << "Cliente " << clienteId << " conectado (activos: " << activos << ")" << std::endl;
+
+    // Sin Nagle: cada vaciado ya junta todo lo de la iteración, y así una
+    // respuesta interactiva no espera el ACK del segmento anterior.
+    int uno = 1;
+    setsockopt(sockCliente, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+
+    auto c = std::make_shared<Conexion>();
+    c->sock = sockCliente;
+    c->id = clienteId;
+    c->dueno = &r;
+    c->ultimaActividad = Reloj::now();
+    c->origen = std::move(origen);
+    if (!adoptarConexion(c)) {
+        marcarCierre(*c);
+        return;
+    }
+    // El nombre pudo haber llegado junto con la conexión
+    if (!r.anillo) manejarCliente(c.get());
+}
+
+static void aceptarClientes(Reactor &r, int nClientes) {
+    int sockCliente;
+    struct sockaddr_in confCliente;
+    while (aceptarConexion(sockCliente, r.sockServidor, confCliente)) nuevaConexion(r, sockCliente, &confCliente, nClientes);
+}
+
+// io_uring: datos de la recepción multishot. Se copian del buffer provisto al
+// buffer de entrada (los mensajes pueden cruzar buffers) y el buffer vuelve
+// al anillo de inmediato.
+static void recibidoAnillo(Reactor &r, OperacionIO *op, const struct io_uring_cqe &cqe) {
+    Conexion &c = *op->conn;
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+        uint16_t id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        bool datos = cqe.res > 0 && !c.cerrando;
+        if (datos) {
+            size_t libre;
+            char *destino = c.entrada.espacio(cqe.res, libre);
+            std::memcpy(destino, r.anillo->buffer(id), cqe.res);
+            c.entrada.escrito(cqe.res);
+            c.ultimaActividad = Reloj::now();
+            metricas().bytesEntrada.sumar(cqe.res);
+        }
+        r.anillo->devolverBuffer(id);
+        if (datos) {
+            procesarEntrada(c);
+            if (!c.cerrando) finDeLectura(c);
+        }
+    }
+    if (cqe.flags & IORING_CQE_F_MORE) return;
+
+    // La recepción terminó: sin buffers libres o por el kernel se rearma; por
+    // cierre del cliente, error o cancelación queda desarmada.
+    if (cqe.res == -ENOBUFS) metricas().sinBuffers.sumar();
+    if (!c.cerrando && !c.traspasoA && (cqe.res > 0 || cqe.res == -ENOBUFS)) {
+        r.anillo->recibirMultishot(c.sock, op);
+        return;
+    }
+    std::shared_ptr<Conexion> propia = std::move(op->conn);
+    c.recepcion = nullptr;
+    delete op;
+    if (!c.cerrando && !c.traspasoA) marcarCierre(c); // cierre (res == 0) o error
+    retomarTraspaso(c);
+}
+
+// io_uring: completado de un envío. Si quedó algo en la cola (envío parcial o
+// mensajes nuevos) sale el siguiente.
+static void enviadoAnillo(OperacionIO *op, int res) {
+    std::shared_ptr<Conexion> c = std::move(op->conn);
+    size_t enviado = 0;
+    for (auto &v : op->iov) enviado += v.iov_len;
+    delete op;
+    bool fallida, pendiente;
+    {
+        auto lock = bloquear(c->salida_mutex, LockMedido::Salida);
+        c->enVuelo = 0;
+        if (c->cerrada) return;
+        if (res < 0) c->fallida = true;
+        else consumirSalida(*c, res);
+        // Envío parcial: el resto no cupo en el socket
+        if (res >= 0 && (size_t)res < enviado) c->bytesRechazados = c->bytesSalida;
+        fallida = c->fallida;
+        pendiente = !c->salida.empty();
+    }
+    MetricasHilo &m = metricas();
+    m.escrituras.sumar();
+    if (res > 0) {
+        m.bytesSalida.sumar(res);
+        bytesEnColas -= res;
+    }
+    if (fallida) marcarCierre(*c);
+    else if (c->traspasoA) retomarTraspaso(*c);
+    else if (pendiente) vaciarSalidaAnillo(*c);
+}
+
+// io_uring: atiende un completado del anillo
+static void completarIO(Reactor &r, const struct io_uring_cqe &cqe, int nClientes, int sockAdmin) {
+    auto *op = reinterpret_cast<OperacionIO *>(cqe.user_data);
+    if (!op) return; // completado de una cancelación
+    bool mas = cqe.flags & IORING_CQE_F_MORE;
+    switch (op->tipo) {
+    case OperacionIO::Aceptar:
+        if (cqe.res >= 0) nuevaConexion(r, cqe.res, nullptr, nClientes);
+        else if (cqe.res != -ECONNABORTED && cqe.res != -EINTR)
+            std::cerr << "Error accepting: " << std::strerror(-cqe.res) << std::endl;
+        if (mas) return;
+        // Sin descriptores u otro error persistente: se reintenta más tarde
+        if (cqe.res < 0)
+            programarTemporizador(std::chrono::milliseconds(100), [&r, op]{ r.anillo->aceptarMultishot(r.sockServidor, op); });
+        else
+            r.anillo->aceptarMultishot(r.sockServidor, op);
+        return;
+    case OperacionIO::Recibir:
+        recibidoAnillo(r, op, cqe);
+        return;
+    case OperacionIO::Enviar:
+        enviadoAnillo(op, cqe.res);
+        return;
+    case OperacionIO::Despertar: {
+        uint64_t cuenta;
+        while (read(r.eventfd, &cuenta, sizeof(cuenta)) > 0) {}
+        r.avisado = false;
+        if (!mas) r.anillo->sondearMultishot(r.eventfd, op);
+        return;
+    }
+    case OperacionIO::Admin:
+        atenderAdmin(sockAdmin);
+        if (!mas) r.anillo->sondearMultishot(sockAdmin, op);
+        return;
+    }
+}
+
+// Subir el límite de descriptores abiertos al máximo permitido
+static void ajustarLimiteDescriptores() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
+            std::cerr << "Warning: setrlimit(RLIMIT_NOFILE) falló: " << std::strerror(errno) << std::endl;
+    }
+}
+
+static void mostrarUso(const char *prog) {
+    std::cerr << "Uso: " << prog << " <nClientes> [opciones]  (ej: " << prog << " 1)\n"
+              << "     " << prog << " --compilar-banco <preguntas.tsv> <banco.bin>\n"
+              << "  --banco=ARCHIVO     banco de trivia compilado (defecto: preguntas incorporadas)\n"
+              << "  --preguntas-trivia=N preguntas por partida de trivia (defecto 4)\n"
+              << "  --inactividad=SEG   desconectar clientes sin actividad (0 = nunca, defecto 900)\n"
+              << "  --admin=PUERTO      estadísticas en 127.0.0.1:PUERTO (defecto: sin puerto; /stats sigue disponible)\n"
+              << "  --emparejamiento=M  RPS PvP: fifo (orden de llegada, defecto) o rating (Elo)\n"
+              << "  --reactores=N       hilos con su propio epoll y socket (SO_REUSEPORT); 0 = uno por núcleo, defecto 1\n"
+              << "  --fijar-cpu         fijar cada reactor a un núcleo\n"
+              << "  --io=MODO           epoll (defecto) o uring (io_uring: accept/recv multishot, envíos en lote)\n"
+              << "  --salida-alta=BYTES marca alta de la cola de salida por cliente (defecto " << MAX_SALIDA_BYTES << ")\n"
+              << "  --salida-baja=BYTES marca baja, donde se reanuda el chat (defecto: alta / 4)\n"
+              << "  --lentos=POLITICA   cliente sobre la marca alta: desconectar (defecto), descartar\n"
+              << "                      (los mensajes de chat más viejos) o pausar (el chat, no los juegos)\n"
+              << "  --tasa-mensajes=N   chat y /msg por segundo por conexión, ráfagas de 2 s (0 = sin límite, defecto 50)\n"
+              << "  --tasa-mensajes-ip=N chat y /msg por segundo por dirección de origen (0 = sin límite, defecto)\n"
+              << "  --tasa-conexiones-ip=N conexiones nuevas/s por dirección de origen (0 = sin límite, defecto)\n"
+              << "  --trabajadores=N    hilos para trabajo diferido: reportes de /stats (0 = en el reactor, defecto 2)" << std::endl;
+}
+
+// Identifican al puerto de administración y al eventfd en el epoll
+static int marcaAdmin;
+static int marcaEventfd;
+
+// Trabajo del final de cada iteración: temporizadores, buzón, vaciado de
+// salida y cierres
+static void finDeIteracion(Reactor &r) {
+    ejecutarTemporizadores();
+    procesarBuzon();
+    if (r.indice == 0) procesarEmparejamiento();
+    procesarVaciados();
+    cerrarPendientes();
+    entregarSalientes();
+    r.iteracion++;
+}
+
+// Tamaño del anillo io_uring y de sus buffers provistos, por reactor
+static constexpr unsigned kEntradasAnillo = 1024;
+static constexpr unsigned kBuffersAnillo = 1024;      // potencia de dos
+static constexpr unsigned kTamBufferAnillo = 4 * BUFFERSIZE;
+
+// Bucle de un reactor con io_uring: una sola llamada por iteración entrega
+// los envíos preparados y espera completados o el próximo temporizador
+static void ejecutarReactorAnillo(Reactor &r, int nClientes, int sockAdmin) {
+    std::string error;
+    r.anillo = std::make_unique<AnilloIO>();
+    if (!r.anillo->iniciar(kEntradasAnillo, error) || !r.anillo->registrarBuffers(kBuffersAnillo, kTamBufferAnillo, error)) {
+        std::cerr << "Error io_uring (reactor " << r.indice << "): " << error << std::endl;
+        exit(1);
+    }
+    r.anillo->aceptarMultishot(r.sockServidor, &r.opAceptar);
+    r.anillo->sondearMultishot(r.eventfd, &r.opDespertar);
+    if (sockAdmin >= 0) r.anillo->sondearMultishot(sockAdmin, &r.opAdmin);
+
+    while (!deteniendo.load(std::memory_order_acquire)) {
+        r.anillo->esperar(msHastaProximoTemporizador());
+        r.anillo->completados([&](const struct io_uring_cqe &cqe){ completarIO(r, cqe, nClientes, sockAdmin); });
+        finDeIteracion(r);
+    }
+}
+
+// Bucle de un reactor: eventos de sus conexiones y, al final de cada
+// iteración, temporizadores, buzón, vaciado de salida y cierres
+static void ejecutarReactor(Reactor &r, int nClientes, int sockAdmin) {
+    reactorActual = &r;
+    if (config.ioUring) {
+        ejecutarReactorAnillo(r, nClientes, sockAdmin);
+        return;
+    }
+    struct epoll_event eventos[MAX_EVENTOS];
+
+    while (!deteniendo.load(std::memory_order_acquire)) {
+        int n = epoll_wait(r.epfd, eventos, MAX_EVENTOS, msHastaProximoTemporizador());
+        metricas().llamadasES.sumar();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error epoll_wait: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            if (eventos[i].data.ptr == nullptr) {
+                aceptarClientes(r, nClientes);
+                continue;
+            }
+            if (eventos[i].data.ptr == &marcaAdmin) {
+                atenderAdmin(sockAdmin);
+                continue;
+            }
+            if (eventos[i].data.ptr == &marcaEventfd) {
+                uint64_t cuenta;
+                while (read(r.eventfd, &cuenta, sizeof(cuenta)) > 0) {}
+                // Lo publicado desde aquí vuelve a avisar; lo anterior se
+                // atiende al final de esta iteración
+                r.avisado = false;
+                continue;
+            }
+            Conexion *c = static_cast<Conexion *>(eventos[i].data.ptr);
+            if (eventos[i].events & EPOLLOUT) vaciarSalida(*c);
+            if (eventos[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) manejarCliente(c);
+        }
+
+        finDeIteracion(r);
+    }
+}
+
+// Núcleos en los que el proceso puede correr (su máscara de afinidad, que
+// puede ser menor que la máquina bajo taskset o un cgroup)
+static std::vector<int> cpusPermitidas() {
+    std::vector<int> cpus;
+    cpu_set_t mascara;
+    CPU_ZERO(&mascara);
+    if (sched_getaffinity(0, sizeof(mascara), &mascara) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &mascara)) cpus.push_back(cpu);
+    return cpus;
+}
+
+// Fija el hilo a un núcleo (reactor i -> i-ésimo núcleo permitido, en ronda)
+static void fijarCpu(pthread_t hilo, int i, const std::vector<int> &permitidas) {
+    if (permitidas.empty()) return;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(permitidas[i % permitidas.size()], &cpus);
+    int err = pthread_setaffinity_np(hilo, sizeof(cpus), &cpus);
+    if (err != 0)
+        std::cerr << "Warning: no se pudo fijar el reactor " << i << " a un núcleo: " << std::strerror(err) << std::endl;
+}
+
+// SIGINT/SIGTERM: marca la parada y despierta al primer reactor, que al salir
+// de su bucle despierta y espera a los demás
+static int eventfdPrincipal = -1;
+static void pedirParada(int) {
+    deteniendo.store(true, std::memory_order_release);
+    uint64_t uno = 1;
+    ssize_t escrito = write(eventfdPrincipal, &uno, sizeof(uno));
+    (void)escrito;
+}
+
+// Lee las opciones --nombre=valor que siguen a <nClientes>
+static bool leerOpciones(int argc, char *argv[]) {
+    bool conBaja = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t igual = arg.find('=');
+        std::string nombre = arg.substr(0, igual);
+        std::string valor = (igual == std::string::npos ? "" : arg.substr(igual + 1));
+        try {
+            if (nombre == "--inactividad") {
+                config.inactividadSeg = std::stoi(valor);
+                if (config.inactividadSeg < 0) throw std::invalid_argument(valor);
+            } else if (nombre == "--admin") {
+                config.puertoAdmin = std::stoi(valor);
+                if (config.puertoAdmin < 0 || config.puertoAdmin > 65535) throw std::invalid_argument(valor);
+            } else if (nombre == "--banco") {
+                if (valor.empty()) throw std::invalid_argument(valor);
+                config.banco = valor;
+            } else if (nombre == "--preguntas-trivia") {
+                config.preguntasTrivia = std::stoi(valor);
+                if (config.preguntasTrivia < 1 || config.preguntasTrivia > 100) throw std::invalid_argument(valor);
+            } else if (nombre == "--emparejamiento") {
+                if (valor == "rating") config.emparejarPorRating = true;
+                else if (valor == "fifo") config.emparejarPorRating = false;
+                else throw std::invalid_argument(valor);
+            } else if (nombre == "--reactores") {
+                config.reactores = std::stoi(valor);
+                if (config.reactores < 0 || config.reactores > 256) throw std::invalid_argument(valor);
+                if (config.reactores == 0) config.reactores = std::max(1u, std::thread::hardware_concurrency());
+            } else if (arg == "--fijar-cpu") {
+                config.fijarCpu = true;
+            } else if (nombre == "--io") {
+                if (valor == "uring") config.ioUring = true;
+                else if (valor == "epoll") config.ioUring = false;
+                else throw std::invalid_argument(valor);
+            } else if (nombre == "--salida-alta" || nombre == "--salida-baja") {
+                long long bytes = std::stoll(valor);
+                if (bytes < BUFFERSIZE || bytes > (1LL << 30)) throw std::invalid_argument(valor);
+                (nombre == "--salida-alta" ? config.salidaAlta : config.salidaBaja) = bytes;
+                conBaja |= (nombre == "--salida-baja");
+            } else if (nombre == "--tasa-mensajes" || nombre == "--tasa-mensajes-ip" || nombre == "--tasa-conexiones-ip") {
+                double tasa = std::stod(valor);
+                if (!(tasa >= 0 && tasa <= 1e6)) throw std::invalid_argument(valor);
+                (nombre == "--tasa-mensajes" ? config.tasaMensajes
+                 : nombre == "--tasa-mensajes-ip" ? config.tasaMensajesIp : config.tasaConexionesIp) = tasa;
+            } else if (nombre == "--trabajadores") {
+                config.trabajadores = std::stoi(valor);
+                if (config.trabajadores < 0 || config.trabajadores > 256) throw std::invalid_argument(valor);
+            } else if (nombre == "--lentos") {
+                if (valor == "desconectar") config.lentos = PoliticaLentos::Desconectar;
+                else if (valor == "descartar") config.lentos = PoliticaLentos::DescartarChat;
+                else if (valor == "pausar") config.lentos = PoliticaLentos::PausarChat;
+                else throw std::invalid_argument(valor);
+            } else {
+                std::cerr << "Opción desconocida: " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Valor inválido para " << nombre << ": " << valor << std::endl;
+            return false;
+        }
+    }
+    if (!conBaja) config.salidaBaja = config.salidaAlta / 4;
+    if (config.salidaBaja >= config.salidaAlta) {
+        std::cerr << "La marca baja de salida debe ser menor que la alta" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Modo --compilar-banco: TSV -> archivo binario para --banco
+static int compilarBancoArchivo(const char *entrada, const char *salida) {
+    std::ifstream in(entrada);
+    if (!in) {
+        std::cerr << "No se pudo abrir " << entrada << std::endl;
+        return 1;
+    }
+    std::string imagen, error;
+    if (!compilarBanco(in, imagen, error)) {
+        std::cerr << entrada << ": " << error << std::endl;
+        return 1;
+    }
+    std::ofstream out(salida, std::ios::binary | std::ios::trunc);
+    if (!out.write(imagen.data(), imagen.size())) {
+        std::cerr << "No se pudo escribir " << salida << std::endl;
+        return 1;
+    }
+    BancoTrivia banco;
+    banco.adoptar(std::move(imagen));
+    std::cout << "Banco compilado: " << banco.numPreguntas() << " preguntas, " << banco.numCategorias() << " categorías" << std::endl;
+    return 0;
+}
+
+// Carga el banco indicado con --banco o, si no hay, el incorporado
+static bool cargarBancoTrivia() {
+    std::string error;
+    if (!config.banco.empty()) {
+        if (!bancoTrivia.abrir(config.banco, error)) {
+            std::cerr << "Error cargando banco de trivia: " << error << std::endl;
+            return false;
+        }
+    } else {
+        std::istringstream in(kBancoIncorporado);
+        std::string imagen;
+        if (!compilarBanco(in, imagen, error) || !bancoTrivia.adoptar(std::move(imagen))) {
+            std::cerr << "Error en el banco incorporado: " << error << std::endl;
+            return false;
+        }
+    }
+    reglasTrivia = armarReglasTrivia(std::min<size_t>(config.preguntasTrivia, bancoTrivia.numPreguntas()));
+    std::cout << "Banco de trivia: " << bancoTrivia.numPreguntas() << " preguntas, "
+              << bancoTrivia.numCategorias() << " categorías" << std::endl;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+        if (argc < 2) {
+            mostrarUso(argv[0]);
+            return 1;
+        }
+
+        if (std::string(argv[1]) == "--compilar-banco") {
+            if (argc != 4) {
+                mostrarUso(argv[0]);
+                return 1;
+            }
+            return compilarBancoArchivo(argv[2], argv[3]);
+        }
+
+        int nClientes = 0;
+        try {
+            nClientes = std::stoi(argv[1]);
+        } catch (const std::invalid_argument &e) {
+            std::cerr << "Argumento inválido para nClientes: debe ser un número entero positivo.\n";
+            mostrarUso(argv[0]);
+            return 1;
+        } catch (const std::out_of_range &e) {
+            std::cerr << "Argumento fuera de rango para nClientes." << std::endl;
+            return 1;
+        }
+
+        if (nClientes < 1) {
+            std::cerr << "nClientes debe ser >= 1" << std::endl;
+            return 1;
+        }
+
+        if (!leerOpciones(argc, argv)) {
+            mostrarUso(argv[0]);
+            return 1;
+        }
+
+        ajustarLimiteDescriptores();
+        if (!cargarBancoTrivia()) return 1;
+
+        if (config.ioUring) {
+            // Fallar al inicio, antes de levantar reactores, si el kernel no tiene
+            // io_uring (o está deshabilitado) o no admite anillos de buffers
+            // provistos (IORING_REGISTER_PBUF_RING, desde 5.19)
+            AnilloIO prueba;
+            std::string error;
+            if (!prueba.iniciar(8, error) || !prueba.registrarBuffers(kBuffersAnillo, kTamBufferAnillo, error)) {
+                std::cerr << "io_uring no disponible: " << error << std::endl;
+                return 1;
+            }
+        }
+
+        // 1-3. Un reactor por hilo, cada uno con su socket de escucha
+        for (int i = 0; i < config.reactores; ++i) {
+            auto r = std::make_unique<Reactor>();
+            r->indice = i;
+            r->salientes.resize(config.reactores);
+            crearSocket(r->sockServidor);
+            struct sockaddr_in confServidor;
+            configurarServidor(r->sockServidor, confServidor);
+            escucharClientes(r->sockServidor);
+
+            // eventfd para que otros hilos avisen que hay trabajo en el buzón
+            r->eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (r->eventfd < 0) {
+                std::cerr << "Error eventfd: " << std::strerror(errno) << std::endl;
+                return 1;
+            }
+            // Con io_uring cada reactor arma su anillo en su propio hilo
+            if (!config.ioUring) {
+                r->epfd = epoll_create1(EPOLL_CLOEXEC);
+                if (r->epfd < 0) {
+                    std::cerr << "Error epoll_create1: " << std::strerror(errno) << std::endl;
+                    return 1;
+                }
+                struct epoll_event evServidor;
+                evServidor.events = EPOLLIN | EPOLLET;
+                evServidor.data.ptr = nullptr; // nullptr identifica al socket de escucha
+                struct epoll_event evDespertar;
+                evDespertar.events = EPOLLIN;
+                evDespertar.data.ptr = &marcaEventfd;
+                if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->sockServidor, &evServidor) < 0
+                    || epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->eventfd, &evDespertar) < 0) {
+                    std::cerr << "Error epoll_ctl: " << std::strerror(errno) << std::endl;
+                    return 1;
+                }
+            }
+            reactores.push_back(std::move(r));
+        }
+
+        std::cout << "Servidor escuchando en puerto " << PORT << std::endl;
+        std::cout << "Máximo de clientes simultáneos: " << nClientes << std::endl;
+        if (config.reactores > 1) std::cout << "Reactores: " << config.reactores << std::endl;
+        if (config.ioUring) std::cout << "E/S: io_uring" << std::endl;
+
+        // Puerto de administración (estadísticas), en el primer reactor
+        int sockAdmin = config.puertoAdmin ? crearSocketAdmin(config.puertoAdmin) : -1;
+        if (sockAdmin >= 0 && !config.ioUring) {
+            struct epoll_event evAdmin;
+            evAdmin.events = EPOLLIN | EPOLLET;
+            evAdmin.data.ptr = &marcaAdmin;
+            epoll_ctl(reactores[0]->epfd, EPOLL_CTL_ADD, sockAdmin, &evAdmin);
+        }
+        if (sockAdmin >= 0) std::cout << "Estadísticas en 127.0.0.1:" << config.puertoAdmin << std::endl;
+
+        std::cout << "Esperando conexiones..." << std::endl;
 
-            // Aceptada
-            clienteIdCounter++;
-            activeClients++;
-            std::cout << "Cliente " << clienteIdCounter << " conectado (activos: " << activeClients.load() << ")" << std::endl;
+        eventfdPrincipal = reactores[0]->eventfd;
+        struct sigaction parada;
+        std::memset(&parada, 0, sizeof(parada));
+        parada.sa_handler = pedirParada;
+        sigemptyset(&parada.sa_mask);
+        sigaction(SIGINT, &parada, nullptr);
+        sigaction(SIGTERM, &parada, nullptr);
 
-            // Crear hilo detachable para manejar el cliente
-            std::thread t(manejarCliente, sockCliente, clienteIdCounter);
-            t.detach();
+        // 4. Trabajadores del ejecutor. El primer reactor corre en este hilo;
+        // los demás en hilos propios hasta que se pide la parada
+        ejecutor.iniciar(config.trabajadores, kMaxTareasDiferidas);
+        std::vector<int> permitidas = config.fijarCpu ? cpusPermitidas() : std::vector<int>();
+        std::vector<std::thread> hilos;
+        for (int i = 1; i < config.reactores; ++i) {
+            hilos.emplace_back(ejecutarReactor, std::ref(*reactores[i]), nClientes, -1);
+            if (config.fijarCpu) fijarCpu(hilos.back().native_handle(), i, permitidas);
         }
+        if (config.fijarCpu) fijarCpu(pthread_self(), 0, permitidas);
+        ejecutarReactor(*reactores[0], nClientes, sockAdmin);
 
-        close(sockServidor);
+        // El primer reactor salió (parada o error): los demás terminan su
+        // iteración y salen antes de que se detenga el ejecutor
+        deteniendo.store(true, std::memory_order_release);
+        for (int i = 1; i < config.reactores; ++i) reactores[i]->despertar();
+        for (auto &hilo : hilos) hilo.join();
+        ejecutor.detener();
+        if (sockAdmin >= 0) close(sockAdmin);
         std::cout << "Servidor cerrado" << std::endl;
         return 0;
 }